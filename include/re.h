@@ -5,27 +5,176 @@
 #ifndef RE_H
 #define RE_H
 
+#include <functional>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace re {
-    class DFANode;
+    class Engine;
+    class Prefilter;
+    class RegexNode;
+
+    enum Flag {
+        NONE = 0,
+        ICASE = 1 << 0, // Case-insensitive, same as inline (?i)
+        MULTILINE = 1 << 1, // ^ and $ also match at line breaks, same as inline (?m)
+        // JIT-compile the DFA to native code, on x86-64 Linux only. Patterns that would use the bit-parallel engine get
+        // the DFA instead. A literal or a byte class keeps its own search, and a DFA too big for the JIT stays
+        // interpreted: match_plan() tells whether it was honoured.
+        NATIVE = 1 << 2,
+        // Determinize on the calling thread only, for callers that already keep every core busy. Otherwise large
+        // automata are built on up to RE::MAX_THREADS threads.
+        SERIAL = 1 << 3,
+    };
+
+    // Which end match_pos reports
+    enum MatchKind {
+        Earliest, // Stop at the first accepting position
+        LeftmostLongest, // The longest match (POSIX)
+        LeftmostFirst, // The match preferred by alternation order and greedy repeats (Perl)
+    };
+
+    // How compile() runs a pattern, from cheapest to most general
+    enum Plan {
+        LiteralPlan, // One fixed string: compare and substring search
+        ByteClassPlan, // One byte class, optionally repeated with +: scan for a member
+        BitParallelPlan, // Few enough positions for the bit-parallel Glushkov automaton
+        DFAPlan, // The determinized automaton
+        NativeDFAPlan, // The determinized automaton compiled to machine code, see NATIVE
+        LazyDFAPlan, // Determinization would blow up: states are built as matching reaches them, shared by all threads
+        // Search finds an inner or suffix literal and walks a reverse DFA back from it, over the automaton plan
+        // compile() chose (BitParallel, DFA, NativeDFA or LazyDFA) for matching. plan() then hides that underlying plan,
+        // match_plan() still reports it.
+        ReverseSearchPlan,
+    };
+
+    template<typename Signature>
+    class FunctionRef;
+
+    // Non-owning reference to a callable for the duration of a call. Unlike std::function it never allocates.
+    template<typename R, typename... Args>
+    class FunctionRef<R(Args...)> {
+        void *object;
+        R (*call)(void *, Args...);
+
+    public:
+        template<typename F> requires (!std::is_same_v<std::remove_cvref_t<F>, FunctionRef>)
+        FunctionRef(F &&f) : object(const_cast<void *>(static_cast<const void *>(std::addressof(f)))),
+                             call([](void *object, Args... args) -> R {
+                                 return (*static_cast<std::remove_reference_t<F> *>(object))(
+                                     std::forward<Args>(args)...);
+                             }) {
+        }
+
+        R operator()(Args... args) const {
+            return call(object, std::forward<Args>(args)...);
+        }
+    };
 
     class RE {
         std::string re_str;
-        std::shared_ptr<DFANode> root;
+        int flags;
+        MatchKind kind;
+        Plan plan_; // Of engine, and of unanchored too unless reversed
+        bool reversed = false; // unanchored is a ReverseSearch
+        std::shared_ptr<Engine> engine; // For anchored matching
+        std::shared_ptr<Engine> unanchored; // For search, may be the same engine
+        // An engine built by the first call that needs it. Shared so copies of an RE build it once between them.
+        struct OnDemand {
+            std::once_flag once;
+            std::shared_ptr<Engine> engine;
+        };
+
+        std::shared_ptr<OnDemand> line_engine; // For scan_lines
+        std::shared_ptr<OnDemand> batch_engine; // DFA for match_batch under BitParallelPlan, nullptr past MAX_BATCH_STATES
+        std::shared_ptr<Prefilter> prefilter; // nullptr unless every match starts with one of a few literals
+
+        static std::string join(const std::vector<std::string> &patterns);
+
+        // For DFA::build: 1 under SERIAL, else the cores up to MAX_THREADS
+        unsigned threads() const;
+
+        // Picks the bit-parallel engine, the DFA or the lazy DFA for engine and unanchored
+        void plan_automaton(const std::shared_ptr<RegexNode> &ast);
+
+        // The leftmost match at or after `at`, ending where match_pos would
+        bool find(std::string_view input, size_t at, size_t &start, size_t &end);
+
+        // Calls on_match(start, end) for up to limit non-overlapping matches from left to right, returns how many.
+        // An empty match right where the previous one ended is skipped. Templates rather than std::function, which
+        // may allocate for the captures, and only instantiated in replace.cpp.
+        template<typename OnMatch>
+        size_t for_each_match(std::string_view input, size_t limit, OnMatch &&on_match);
+
+        // Hands put the pieces of input with up to limit matches replaced, returns the number replaced
+        template<typename Put>
+        size_t replace(std::string_view input, std::string_view replacement, size_t limit, Put &&put);
 
     public:
-        explicit RE(std::string re_str) : re_str(std::move(re_str)) {
+        explicit RE(std::string re_str, int flags = NONE, MatchKind kind = LeftmostLongest) :
+            re_str(std::move(re_str)), flags(flags), kind(kind) {
             this->compile();
         }
 
+        // Matches any of the patterns, each keeping its own inline flags
+        explicit RE(const std::vector<std::string> &patterns, int flags = NONE, MatchKind kind = LeftmostLongest) :
+            RE(join(patterns), flags, kind) {
+        }
+
+        static constexpr size_t MAX_DFA_STATES = 4096; // Beyond this the DFA is built lazily instead
+        static constexpr unsigned MAX_THREADS = 4; // Per determinization
+        static constexpr size_t MAX_BATCH_STATES = 64; // Of the DFA match_batch builds for BitParallelPlan
+
         void compile();
 
-        int match_pos(std::string input);
+        Plan plan() const {
+            return reversed ? ReverseSearchPlan : plan_;
+        }
+
+        // The plan of anchored matching, the same as plan() unless search is reversed
+        Plan match_plan() const {
+            return plan_;
+        }
+
+        int match_pos(std::string_view input);
+
+        bool match(std::string_view input);
+
+        bool search(std::string_view input);
+
+        // results[i] = match(inputs[i]), interleaving several inputs on one core to hide transition load latency. Under
+        // BitParallelPlan the first call determinizes the pattern for this, up to MAX_BATCH_STATES states, and matches
+        // each input on its own when the DFA does not fit.
+        void match_batch(const std::string_view *inputs, size_t count, bool *results);
+
+        // Calls on_line (without its '\n') for every line that contains a match, or that does not when invert is set,
+        // and returns how many lines were selected. Every line is matched as if it were the whole input.
+        size_t scan_lines(std::string_view text, const std::function<void(std::string_view)> &on_line,
+                          bool invert = false);
+
+        // scan_lines over a memory-mapped file
+        size_t scan_file(const std::string &path, const std::function<void(std::string_view)> &on_line,
+                         bool invert = false);
+
+        // Writes input with every match replaced by replacement (taken literally) to out and returns the length of the
+        // result. Like snprintf nothing is written past capacity, a return value above it means the result was cut.
+        size_t replace_all(std::string_view input, std::string_view replacement, char *out, size_t capacity);
+
+        // Same, into out (cleared first), which only allocates when its capacity is too small
+        void replace_all(std::string_view input, std::string_view replacement, std::string &out);
+
+        // replace_all for the leftmost match only
+        size_t replace_first(std::string_view input, std::string_view replacement, char *out, size_t capacity);
+
+        void replace_first(std::string_view input, std::string_view replacement, std::string &out);
 
-        bool match(std::string input);
+        // Calls on_piece for each piece of input between matches, views into input, and returns how many
+        size_t split(std::string_view input, FunctionRef<void(std::string_view)> on_piece);
     };
 }
 
@@ -22,11 +22,68 @@ void NFANode::addEpsilonEdge(std::shared_ptr<NFANode> n) {
     epsilon_edges.emplace_back(n);
 }
 
+void NFANode::addAssertEdge(AssertKind kind, std::shared_ptr<NFANode> n) {
+    assert_edges.emplace_back(kind, n);
+}
+
+bool re::check_Assert(AssertKind kind, Context prev, Context next) {
+    switch (kind) {
+        case TextStart:
+            return prev == EdgeContext;
+        case TextEnd:
+            return next == EdgeContext;
+        case LineStart:
+            return prev == EdgeContext || prev == NewlineContext;
+        case LineEnd:
+            return next == EdgeContext || next == NewlineContext;
+        case WordBoundary:
+            return (prev == WordContext) != (next == WordContext);
+        case NotWordBoundary:
+            return (prev == WordContext) == (next == WordContext);
+    }
+    return false;
+}
+
+
+namespace {
+    // Owns the nodes of one built NFA. Star and the unanchored loop make the edges cyclic, so the last handle on the
+    // NFA clears every node's edges instead of leaving the cycles to keep each other alive.
+    struct NFAGraph {
+        std::vector<std::shared_ptr<NFANode> > nodes;
+
+        ~NFAGraph() {
+            for (auto &node: nodes) {
+                node->edges.clear();
+                node->epsilon_edges.clear();
+                node->assert_edges.clear();
+            }
+        }
+    };
+}
 
-std::shared_ptr<NFANode> AST2NFA::build() {
+std::shared_ptr<NFANode> AST2NFA::node() {
+    nodes.push_back(std::make_shared<NFANode>());
+    return nodes.back();
+}
+
+std::shared_ptr<NFANode> AST2NFA::build(bool anchored) {
+    nodes.clear();
     Fragment frag = _build(ast);
     frag.end->isEnd = true;
-    return frag.start;
+    std::shared_ptr<NFANode> start = frag.start;
+    if (!anchored) {
+        // Unanchored: a lazy loop over every byte in front of the pattern
+        start = node();
+        std::shared_ptr<NFANode> any = node();
+        start->addEpsilonEdge(frag.start);
+        start->addEpsilonEdge(any);
+        for (int c = -128; c < 128; c++) {
+            any->addEdge(static_cast<char>(c), start);
+        }
+    }
+    auto graph = std::make_shared<NFAGraph>();
+    graph->nodes = std::move(nodes);
+    return {graph, start.get()};
 };
 
 Fragment AST2NFA::_build(std::shared_ptr<RegexNode> childAST) {
@@ -44,6 +101,8 @@ Fragment AST2NFA::_build(std::shared_ptr<RegexNode> childAST) {
         return build_Concat(concat->left, concat->right);
     } else if (auto _or = std::dynamic_pointer_cast<Or>(childAST)) {
         return build_Or(_or->left, _or->right);
+    } else if (auto assert_ = std::dynamic_pointer_cast<Assert>(childAST)) {
+        return build_Assert(assert_->kind);
     } else if (auto group = std::dynamic_pointer_cast<Group>(childAST)) {
         return build_Group(group->body);
     } else if (auto ncgroup = std::dynamic_pointer_cast<NoneCaptureGroup>(childAST)) {
@@ -54,61 +113,71 @@ Fragment AST2NFA::_build(std::shared_ptr<RegexNode> childAST) {
 };
 
 Fragment AST2NFA::build_Empty() {
-    std::shared_ptr<NFANode> s = std::make_shared<NFANode>();
-    std::shared_ptr<NFANode> e = std::make_shared<NFANode>();
+    std::shared_ptr<NFANode> s = node();
+    std::shared_ptr<NFANode> e = node();
     s->addEpsilonEdge(e);
     return {s, e};
 }
 
 Fragment AST2NFA::build_Char(char c) {
-    std::shared_ptr<NFANode> s = std::make_shared<NFANode>();
-    std::shared_ptr<NFANode> e = std::make_shared<NFANode>();
+    std::shared_ptr<NFANode> s = node();
+    std::shared_ptr<NFANode> e = node();
+    if (lines && c == '\n') {
+        return {s, e};
+    }
     s->addEdge(c, e);
     return {s, e};
 }
 
 Fragment AST2NFA::build_Set(const std::vector<char> &elements) {
-    std::shared_ptr<NFANode> s = std::make_shared<NFANode>();
-    std::shared_ptr<NFANode> e = std::make_shared<NFANode>();
+    std::shared_ptr<NFANode> s = node();
+    std::shared_ptr<NFANode> e = node();
+    // Every element goes straight to e: a node per element would put each byte of a class in its own DFA state, so
+    // that no state of a gap like .* loops on itself
     for (char x: elements) {
-        std::shared_ptr<NFANode> m = std::make_shared<NFANode>();
-        s->addEdge(x, m);
-        m->addEpsilonEdge(e);
+        if ((lines && x == '\n') || s->edges.contains(x)) {
+            continue;
+        }
+        s->addEdge(x, e);
     }
     return {s, e};
 }
 
 Fragment AST2NFA::build_Repeat(std::shared_ptr<RegexNode> body, int min, int max) {
-    std::shared_ptr<NFANode> s = std::make_shared<NFANode>();
-    std::shared_ptr<NFANode> e = std::make_shared<NFANode>();
+    std::shared_ptr<NFANode> s = node();
+    std::shared_ptr<NFANode> e = node();
     Fragment cur = {s, s};
     for (int i = 0; i < min; i++) {
         Fragment m = _build(body);
         cur.end->addEpsilonEdge(m.start);
         cur.end = m.end;
     }
-    cur.end->addEpsilonEdge(e);
+    // Edges are added greedy first: taking one more body has priority over leaving
     for (int i = 0; i < max - min; i++) {
         Fragment m = _build(body);
         cur.end->addEpsilonEdge(m.start);
-        cur.end = m.end;
         cur.end->addEpsilonEdge(e);
+        cur.end = m.end;
     }
+    cur.end->addEpsilonEdge(e);
     return {s, e};
 }
 
 Fragment AST2NFA::build_Star(std::shared_ptr<RegexNode> body) {
-    std::shared_ptr<NFANode> s = std::make_shared<NFANode>();
-    std::shared_ptr<NFANode> e = std::make_shared<NFANode>();
-    s->addEpsilonEdge(e);
+    std::shared_ptr<NFANode> s = node();
+    std::shared_ptr<NFANode> e = node();
     Fragment m = _build(std::move(body));
     s->addEpsilonEdge(m.start);
-    m.end->addEpsilonEdge(e);
+    s->addEpsilonEdge(e);
     m.end->addEpsilonEdge(m.start);
+    m.end->addEpsilonEdge(e);
     return {s, e};
 }
 
 Fragment AST2NFA::build_Concat(std::shared_ptr<RegexNode> left, std::shared_ptr<RegexNode> right) {
+    if (reverse) {
+        std::swap(left, right);
+    }
     Fragment l = _build(std::move(left));
     Fragment r = _build(std::move(right));
     l.end->addEpsilonEdge(r.start);
@@ -116,8 +185,8 @@ Fragment AST2NFA::build_Concat(std::shared_ptr<RegexNode> left, std::shared_ptr<
 };
 
 Fragment AST2NFA::build_Or(std::shared_ptr<RegexNode> left, std::shared_ptr<RegexNode> right) {
-    std::shared_ptr<NFANode> s = std::make_shared<NFANode>();
-    std::shared_ptr<NFANode> e = std::make_shared<NFANode>();
+    std::shared_ptr<NFANode> s = node();
+    std::shared_ptr<NFANode> e = node();
     Fragment l = _build(std::move(left));
     Fragment r = _build(std::move(right));
     s->addEpsilonEdge(l.start);
@@ -127,6 +196,24 @@ Fragment AST2NFA::build_Or(std::shared_ptr<RegexNode> left, std::shared_ptr<Rege
     return {s, e};
 };
 
+Fragment AST2NFA::build_Assert(AssertKind kind) {
+    std::shared_ptr<NFANode> s = node();
+    std::shared_ptr<NFANode> e = node();
+    if (lines && kind == TextStart) {
+        kind = LineStart;
+    } else if (lines && kind == TextEnd) {
+        kind = LineEnd;
+    }
+    // Read backwards the bytes before a position come after it, word boundaries look the same either way
+    if (reverse) {
+        static const AssertKind mirror[] = {TextEnd, TextStart, LineEnd, LineStart, WordBoundary, NotWordBoundary};
+        kind = mirror[kind];
+    }
+    s->addAssertEdge(kind, e);
+    hasAssert = true;
+    return {s, e};
+}
+
 Fragment AST2NFA::build_Group(std::shared_ptr<RegexNode> body) {
     return _build(std::move(body));
 };
@@ -14,16 +14,39 @@
 #include "re2ast.h"
 
 namespace re {
+    // What surrounds a position: the byte before it (look-behind) or after it (look-ahead)
+    enum Context : unsigned char {
+        EdgeContext = 0, // Start or end of the input
+        NewlineContext = 1,
+        WordContext = 2,
+        OtherContext = 3,
+    };
+
+    inline Context context_of(char c) {
+        if (c == '\n') {
+            return NewlineContext;
+        }
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+            return WordContext;
+        }
+        return OtherContext;
+    }
+
+    bool check_Assert(AssertKind kind, Context prev, Context next);
 
     class NFANode {
     public:
         bool isEnd = false;
         std::map<char, std::vector<std::shared_ptr<NFANode> > > edges;
         std::vector<std::shared_ptr<NFANode> > epsilon_edges;
+        // Epsilon edges only taken when the assertion holds between the bytes around the position
+        std::vector<std::pair<AssertKind, std::shared_ptr<NFANode> > > assert_edges;
 
         void addEdge(char c, std::shared_ptr<NFANode> n);
 
         void addEpsilonEdge(std::shared_ptr<NFANode> n);
+
+        void addAssertEdge(AssertKind kind, std::shared_ptr<NFANode> n);
     };
 
     struct Fragment {
@@ -33,6 +56,13 @@ namespace re {
 
     class AST2NFA {
         std::shared_ptr<RegexNode> ast;
+        // Line mode: nothing matches across '\n' and text assertions act on lines, so each line matches on its own
+        bool lines;
+        // Matches the reversed strings, for running backwards from the end of a match
+        bool reverse;
+        std::vector<std::shared_ptr<NFANode> > nodes; // Created by the build in progress
+
+        std::shared_ptr<NFANode> node();
 
         Fragment _build(std::shared_ptr<RegexNode> childAST);
 
@@ -50,15 +80,21 @@ namespace re {
 
         Fragment build_Or(std::shared_ptr<RegexNode> left, std::shared_ptr<RegexNode> right);
 
+        Fragment build_Assert(AssertKind kind);
+
         Fragment build_Group(std::shared_ptr<RegexNode> body);
 
         Fragment build_NoneCaptureGroup(std::shared_ptr<RegexNode> body);
 
     public:
-        explicit AST2NFA(std::shared_ptr<RegexNode> ast) : ast(std::move(ast)) {
+        explicit AST2NFA(std::shared_ptr<RegexNode> ast, bool lines = false, bool reverse = false) :
+            ast(std::move(ast)), lines(lines), reverse(reverse) {
         }
 
-        std::shared_ptr<NFANode> build();
+        bool hasAssert = false;
+
+        // The start node. It owns every node of the NFA, whose edges are cleared once the last copy of it is gone.
+        std::shared_ptr<NFANode> build(bool anchored = true);
     };
 }
 #endif //AST2NFA_H
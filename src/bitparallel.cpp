@@ -0,0 +1,233 @@
+//
+// Created by Regt on 25-8-18.
+//
+
+#include "bitparallel.h"
+
+#include <algorithm>
+
+using namespace re;
+
+bool BitParallel::position(const std::vector<char> &chars, Glushkov &g) {
+    if (positions == MAX_POSITIONS) {
+        return false;
+    }
+    uint64_t bit = uint64_t(1) << positions++;
+    follow.push_back(0);
+    for (char c: chars) {
+        classes[static_cast<unsigned char>(c)] |= bit;
+    }
+    g = {bit, bit, false};
+    return true;
+}
+
+BitParallel::Glushkov BitParallel::concat(const Glushkov &l, const Glushkov &r) {
+    for (size_t p = 0; p < positions; p++) {
+        if (l.last >> p & 1) {
+            follow[p] |= r.first;
+        }
+    }
+    return {
+        l.first | (l.nullable ? r.first : 0),
+        r.last | (r.nullable ? l.last : 0),
+        l.nullable && r.nullable
+    };
+}
+
+bool BitParallel::glushkov(const std::shared_ptr<RegexNode> &node, Glushkov &g) {
+    if (std::dynamic_pointer_cast<Empty>(node)) {
+        g = {};
+        return true;
+    } else if (auto ch = std::dynamic_pointer_cast<Char>(node)) {
+        return position({ch->value}, g);
+    } else if (auto set = std::dynamic_pointer_cast<Set>(node)) {
+        return position(set->elements, g);
+    } else if (auto repeat = std::dynamic_pointer_cast<Repeat>(node)) {
+        // Every copy gets its own positions, the ones past min are optional
+        g = {};
+        for (int i = 0; i < repeat->max; i++) {
+            Glushkov copy;
+            if (!glushkov(repeat->body, copy)) {
+                return false;
+            }
+            copy.nullable = copy.nullable || i >= repeat->min;
+            g = concat(g, copy);
+        }
+        return true;
+    } else if (auto star = std::dynamic_pointer_cast<Star>(node)) {
+        if (!glushkov(star->body, g)) {
+            return false;
+        }
+        concat(g, g);
+        g.nullable = true;
+        return true;
+    } else if (auto concat_ = std::dynamic_pointer_cast<Concat>(node)) {
+        Glushkov l, r;
+        if (!glushkov(concat_->left, l) || !glushkov(concat_->right, r)) {
+            return false;
+        }
+        g = concat(l, r);
+        return true;
+    } else if (auto _or = std::dynamic_pointer_cast<Or>(node)) {
+        Glushkov l, r;
+        if (!glushkov(_or->left, l) || !glushkov(_or->right, r)) {
+            return false;
+        }
+        g = {l.first | r.first, l.last | r.last, l.nullable || r.nullable};
+        return true;
+    } else if (auto group = std::dynamic_pointer_cast<Group>(node)) {
+        return glushkov(group->body, g);
+    } else if (auto ncgroup = std::dynamic_pointer_cast<NoneCaptureGroup>(node)) {
+        return glushkov(ncgroup->body, g);
+    }
+    return false;
+}
+
+int32_t BitParallel::accelerate(size_t p, uint64_t reenter) {
+    uint64_t bit = uint64_t(1) << p;
+    if (!(follow[p] & bit) || (root.last & bit)) {
+        return -1;
+    }
+    auto stays = [&](unsigned char c) {
+        return ((follow[p] | reenter) & classes[c]) == bit;
+    };
+    size_t leave = 0;
+    for (char c: Sigma) {
+        if (!stays(c)) {
+            leave++;
+        }
+    }
+    if (leave > ByteSet::MAX_DIRECT) {
+        return -1;
+    }
+    ByteSet set;
+    for (int c = 0; c < 256; c++) {
+        if (!stays(c)) {
+            set.insert(c);
+        }
+    }
+    exits.push_back(set);
+    return exits.size() - 1;
+}
+
+std::shared_ptr<BitParallel> BitParallel::build(const std::shared_ptr<RegexNode> &ast) {
+    auto bp = std::make_shared<BitParallel>();
+    if (!bp->glushkov(ast, bp->root)) {
+        return nullptr;
+    }
+    for (size_t j = 0; j * 8 < bp->positions; j++) {
+        auto &table = bp->followTable.emplace_back();
+        table[0] = 0;
+        for (int subset = 1; subset < 256; subset++) {
+            // Lowest bit's follow joined with the subset without it, which is already filled in
+            int low = __builtin_ctz(subset);
+            uint64_t f = j * 8 + low < bp->positions ? bp->follow[j * 8 + low] : 0;
+            table[subset] = table[subset & (subset - 1)] | f;
+        }
+    }
+    for (size_t p = 0; p < bp->positions; p++) {
+        bp->accel.push_back(bp->accelerate(p, 0));
+        bp->accelSearch.push_back(bp->accelerate(p, bp->root.first));
+    }
+    size_t common = 0;
+    for (int c = 0; c < 256; c++) {
+        if (bp->classes[c] & bp->root.first) {
+            bp->startBytes.insert(c);
+            common += std::find(Sigma.begin(), Sigma.end(), static_cast<char>(c)) != Sigma.end();
+        }
+    }
+    bp->skipToStart = common <= ByteSet::MAX_DIRECT;
+    return bp;
+}
+
+long BitParallel::match(std::string_view input, size_t at, bool earliest) const {
+    long last = -1;
+    if (root.nullable) {
+        last = at;
+        if (earliest) {
+            return last;
+        }
+    }
+    size_t pos = at;
+    if (pos == input.size()) {
+        return last;
+    }
+    uint64_t active = root.first & classes[static_cast<unsigned char>(input[pos++])];
+    while (active) {
+        if (active & root.last) {
+            last = pos;
+            if (earliest) {
+                break;
+            }
+        }
+        if (!(active & (active - 1))) {
+            if (int32_t a = accel[__builtin_ctzll(active)]; a >= 0) {
+                pos = exits[a].find(input, pos);
+            }
+        }
+        if (pos == input.size()) {
+            break;
+        }
+        active = step(active) & classes[static_cast<unsigned char>(input[pos++])];
+    }
+    return last;
+}
+
+long BitParallel::search(std::string_view input, size_t at) const {
+    if (root.nullable) {
+        return at;
+    }
+    uint64_t active = 0;
+    for (size_t pos = at;; pos++) {
+        if (active & root.last) {
+            return pos;
+        }
+        if (!active && skipToStart) {
+            pos = startBytes.find(input, pos);
+        } else if (active && !(active & (active - 1))) {
+            if (int32_t a = accelSearch[__builtin_ctzll(active)]; a >= 0) {
+                pos = exits[a].find(input, pos);
+            }
+        }
+        if (pos == input.size()) {
+            return -1;
+        }
+        active = (step(active) | root.first) & classes[static_cast<unsigned char>(input[pos])];
+    }
+}
+
+long BitParallel::leftmost_start(std::string_view input, size_t at, size_t until) const {
+    if (root.nullable) {
+        return static_cast<long>(at);
+    }
+    // Active positions and where their run started, in start order. Positions are disjoint between runs.
+    thread_local std::vector<std::pair<uint64_t, size_t> > runs;
+    runs.clear();
+    long best = -1; // Earliest start seen to match, later runs are dropped
+    for (size_t pos = at; pos < input.size() && (!runs.empty() || (best < 0 && pos <= until)); pos++) {
+        uint64_t accepts = classes[static_cast<unsigned char>(input[pos])];
+        uint64_t taken = 0;
+        size_t kept = 0;
+        for (auto [active, start]: runs) {
+            active = step(active) & accepts & ~taken;
+            if (active) {
+                taken |= active;
+                runs[kept++] = {active, start};
+            }
+        }
+        runs.resize(kept);
+        if (best < 0 && pos <= until) {
+            if (uint64_t active = root.first & accepts & ~taken) {
+                runs.emplace_back(active, pos);
+            }
+        }
+        for (size_t k = 0; k < runs.size(); k++) {
+            if (runs[k].first & root.last) {
+                best = static_cast<long>(runs[k].second);
+                runs.resize(k);
+                break;
+            }
+        }
+    }
+    return best;
+}
@@ -0,0 +1,73 @@
+//
+// Created by Regt on 25-8-18.
+//
+
+#ifndef BITPARALLEL_H
+#define BITPARALLEL_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "byteset.h"
+#include "engine.h"
+#include "re2ast.h"
+
+namespace re {
+    // Bit-parallel simulation of the Glushkov automaton: one bit per Char/Set position, a step is a follow-table
+    // lookup per 8 active positions ANDed with the positions that accept the byte. Built in time linear in the
+    // pattern, no determinization. Leftmost-longest/earliest only, and no assertions.
+    class BitParallel : public Engine {
+    public:
+        static constexpr size_t MAX_POSITIONS = 64;
+
+    private:
+        struct Glushkov {
+            uint64_t first = 0, last = 0;
+            bool nullable = true;
+        };
+
+        size_t positions = 0;
+        std::vector<uint64_t> follow; // Per position
+        Glushkov root;
+        uint64_t classes[256] = {}; // Positions whose class holds the byte
+        std::vector<std::array<uint64_t, 256> > followTable; // Per 8 positions: follow of each subset
+        // A lone active position that only loops on itself for most bytes is skipped over like an accelerated DFA
+        // state, separately for match (anchored) and search (first positions reenter every byte)
+        std::vector<int32_t> accel, accelSearch; // Index into exits, -1 if not accelerated
+        std::vector<ByteSet> exits;
+        ByteSet startBytes; // Bytes some first position accepts, search skips to them while nothing is active
+        bool skipToStart = false;
+
+        bool glushkov(const std::shared_ptr<RegexNode> &node, Glushkov &g);
+
+        bool position(const std::vector<char> &chars, Glushkov &g);
+
+        Glushkov concat(const Glushkov &l, const Glushkov &r);
+
+        int32_t accelerate(size_t p, uint64_t reenter);
+
+        uint64_t step(uint64_t active) const {
+            uint64_t next = 0;
+            for (size_t j = 0; active; j++, active >>= 8) {
+                next |= followTable[j][active & 0xFF];
+            }
+            return next;
+        }
+
+    public:
+        // nullptr if the pattern has assertions or more than MAX_POSITIONS positions
+        static std::shared_ptr<BitParallel> build(const std::shared_ptr<RegexNode> &ast);
+
+        long match(std::string_view input, size_t at, bool earliest) const override;
+
+        long search(std::string_view input, size_t at) const override;
+
+        // Runs from every start step together, each position held only by the earliest run that reached it: a later
+        // run there has the same future. At most MAX_POSITIONS runs are ever live.
+        long leftmost_start(std::string_view input, size_t at, size_t until) const override;
+    };
+}
+
+#endif //BITPARALLEL_H
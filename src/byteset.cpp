@@ -0,0 +1,103 @@
+//
+// Created by Regt on 25-8-16.
+//
+
+#include "byteset.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RE_BYTESET_SSE
+#endif
+
+using namespace re;
+
+void ByteSet::insert(unsigned char c) {
+    if (contains_[c]) {
+        return;
+    }
+    contains_[c] = true;
+    count++;
+    if (count <= MAX_DIRECT) {
+        bytes.push_back(c);
+    }
+    if (c < 0x80) {
+        loA[c & 0xF] |= 1 << (c >> 4);
+    } else {
+        loB[c & 0xF] |= 1 << ((c >> 4) & 7);
+    }
+}
+
+size_t ByteSet::find(std::string_view input, size_t at) const {
+    if (at >= input.size() || count == 0) {
+        return input.size();
+    }
+    if (count == 1) {
+        auto p = static_cast<const char *>(memchr(input.data() + at, bytes[0], input.size() - at));
+        return p ? p - input.data() : input.size();
+    }
+#ifdef RE_BYTESET_SSE
+    if (count <= MAX_DIRECT) {
+        return find_sse2(input, at);
+    }
+    static const bool ssse3 = __builtin_cpu_supports("ssse3");
+    if (ssse3) {
+        return find_ssse3(input, at);
+    }
+#endif
+    return find_scalar(input, at);
+}
+
+size_t ByteSet::find_scalar(std::string_view input, size_t at) const {
+    auto p = reinterpret_cast<const unsigned char *>(input.data());
+    while (at < input.size() && !contains_[p[at]]) {
+        at++;
+    }
+    return at;
+}
+
+#ifdef RE_BYTESET_SSE
+size_t ByteSet::find_sse2(std::string_view input, size_t at) const {
+    auto p = reinterpret_cast<const unsigned char *>(input.data());
+    size_t n = input.size();
+    __m128i needles[MAX_DIRECT];
+    for (size_t i = 0; i < MAX_DIRECT; i++) {
+        needles[i] = _mm_set1_epi8(static_cast<char>(bytes[i < bytes.size() ? i : 0]));
+    }
+    for (; at + 16 <= n; at += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + at));
+        __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, needles[0]), _mm_cmpeq_epi8(chunk, needles[1])),
+                                  _mm_cmpeq_epi8(chunk, needles[2]));
+        if (unsigned mask = _mm_movemask_epi8(eq)) {
+            return at + __builtin_ctz(mask);
+        }
+    }
+    return find_scalar(input, at);
+}
+
+__attribute__((target("ssse3")))
+size_t ByteSet::find_ssse3(std::string_view input, size_t at) const {
+    auto p = reinterpret_cast<const unsigned char *>(input.data());
+    size_t n = input.size();
+    const __m128i tableA = _mm_loadu_si128(reinterpret_cast<const __m128i *>(loA));
+    const __m128i tableB = _mm_loadu_si128(reinterpret_cast<const __m128i *>(loB));
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i high = _mm_set1_epi8(static_cast<char>(0x80));
+    for (; at + 16 <= n; at += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + at));
+        __m128i low = _mm_and_si128(chunk, nibble);
+        // pshufb yields 0 for indexes with the top bit set, which routes each byte to the A or B table
+        __m128i a = _mm_shuffle_epi8(tableA, _mm_or_si128(low, _mm_and_si128(chunk, high)));
+        __m128i b = _mm_shuffle_epi8(tableB, _mm_or_si128(low, _mm_andnot_si128(chunk, high)));
+        __m128i bit = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble));
+        __m128i hit = _mm_and_si128(_mm_or_si128(a, b), bit);
+        unsigned mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(hit, _mm_setzero_si128())) & 0xFFFF;
+        if (mask) {
+            return at + __builtin_ctz(mask);
+        }
+    }
+    return find_scalar(input, at);
+}
+#endif
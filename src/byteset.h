@@ -0,0 +1,51 @@
+//
+// Created by Regt on 25-8-16.
+//
+
+#ifndef BYTESET_H
+#define BYTESET_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace re {
+    // A set of bytes that can be searched for 16 bytes at a time
+    class ByteSet {
+        bool contains_[256] = {};
+        std::vector<unsigned char> bytes; // Members, when there are few enough to compare directly
+        size_t count = 0;
+        // Nibble tables: lo*[low nibble] has bit h set if the byte with high nibble h (or h + 8) is a member
+        unsigned char loA[16] = {}, loB[16] = {};
+
+        // Byte at a time
+        size_t find_scalar(std::string_view input, size_t at) const;
+
+#if defined(__x86_64__) || defined(__i386__)
+        // 16 bytes at a time, comparing with up to MAX_DIRECT members or looking up the nibble tables
+        size_t find_sse2(std::string_view input, size_t at) const;
+
+        size_t find_ssse3(std::string_view input, size_t at) const;
+#endif
+
+    public:
+        static constexpr size_t MAX_DIRECT = 3;
+
+        ByteSet() = default;
+
+        void insert(unsigned char c);
+
+        bool contains(unsigned char c) const {
+            return contains_[c];
+        }
+
+        size_t size() const {
+            return count;
+        }
+
+        // First position at or after `at` holding a member, input.size() if there is none
+        size_t find(std::string_view input, size_t at) const;
+    };
+}
+
+#endif //BYTESET_H
@@ -0,0 +1,312 @@
+//
+// Created by Regt on 25-8-13.
+//
+
+#include "dfa.h"
+
+#include <algorithm>
+#include <array>
+#include <queue>
+#include <unordered_map>
+
+using namespace re;
+
+DFA::DFA(NFA2DFA &nfa2dfa) {
+    // Number every reachable DFANode, breadth first from the start states
+    std::vector<std::shared_ptr<DFANode> > nodes;
+    std::unordered_map<DFANode *, uint32_t> index;
+    std::queue<DFANode *> queue;
+    std::shared_ptr<DFANode> starts[4];
+    for (int prev = EdgeContext; prev <= OtherContext; prev++) {
+        starts[prev] = nfa2dfa.transform(static_cast<Context>(prev));
+        if (index.emplace(starts[prev].get(), nodes.size()).second) {
+            nodes.push_back(starts[prev]);
+            queue.push(starts[prev].get());
+        }
+    }
+    while (!queue.empty()) {
+        DFANode *node = queue.front();
+        queue.pop();
+        for (auto &[c, child]: node->edges) {
+            if (index.emplace(child.get(), nodes.size()).second) {
+                nodes.push_back(child);
+                queue.push(child.get());
+            }
+        }
+    }
+
+    // Dead states: nothing accepting is reachable from them
+    std::vector<std::vector<uint32_t> > reverse(nodes.size());
+    std::vector<bool> live(nodes.size(), false);
+    std::vector<uint32_t> work;
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        for (auto &[c, child]: nodes[i]->edges) {
+            reverse[index[child.get()]].push_back(i);
+        }
+        if (nodes[i]->accept) {
+            live[i] = true;
+            work.push_back(i);
+        }
+    }
+    while (!work.empty()) {
+        uint32_t i = work.back();
+        work.pop_back();
+        for (uint32_t from: reverse[i]) {
+            if (!live[from]) {
+                live[from] = true;
+                work.push_back(from);
+            }
+        }
+    }
+
+    std::vector<uint32_t> id(nodes.size(), DEAD);
+    uint32_t count = 1;
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        if (live[i]) {
+            id[i] = count++;
+        }
+    }
+    std::vector<uint32_t> wide(count * 256, DEAD);
+    std::vector<unsigned char> accepts(count, 0);
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        if (!live[i]) {
+            continue;
+        }
+        accepts[id[i]] = nodes[i]->accept;
+        for (auto &[c, child]: nodes[i]->edges) {
+            wide[id[i] * 256 + static_cast<unsigned char>(c)] = id[index[child.get()]];
+        }
+    }
+
+    // Only non-accepting states, so skipped positions never need an acceptance check.
+    // Bytes outside Sigma count as exits too but are rare in text, so they do not decide whether to accelerate.
+    std::vector<int32_t> accel(count, -1);
+    std::vector<ByteSet> sets;
+    for (uint32_t state = 1; state < count; state++) {
+        if (accepts[state]) {
+            continue;
+        }
+        size_t leave = 0;
+        for (char c: Sigma) {
+            if (wide[state * 256 + static_cast<unsigned char>(c)] != state) {
+                leave++;
+            }
+        }
+        if (leave > ByteSet::MAX_DIRECT) {
+            continue;
+        }
+        ByteSet set;
+        for (int c = 0; c < 256; c++) {
+            if (wide[state * 256 + c] != state) {
+                set.insert(c);
+            }
+        }
+        accel[state] = sets.size();
+        sets.push_back(set);
+    }
+
+    // Final numbering: DEAD, the accelerated states, the plain ones, then the accepting ones, each range in BFS order
+    // so the states near the start share cache lines
+    std::vector<uint32_t> order = {DEAD};
+    for (uint32_t state = 1; state < count; state++) {
+        if (accel[state] >= 0) {
+            order.push_back(state);
+        }
+    }
+    plain = order.size();
+    for (uint32_t state = 1; state < count; state++) {
+        if (accel[state] < 0 && !accepts[state]) {
+            order.push_back(state);
+        }
+    }
+    accepting = order.size();
+    for (uint32_t state = 1; state < count; state++) {
+        if (accepts[state]) {
+            order.push_back(state);
+        }
+    }
+    std::vector<uint32_t> renumber(count);
+    for (uint32_t state = 0; state < count; state++) {
+        renumber[order[state]] = state;
+    }
+    std::vector<uint32_t> table(count * 256);
+    accept.resize(count);
+    for (uint32_t state = 0; state < count; state++) {
+        accept[state] = accepts[order[state]];
+        if (state >= 1 && state < plain) {
+            exits.push_back(sets[accel[order[state]]]);
+        }
+        for (int c = 0; c < 256; c++) {
+            table[state * 256 + c] = renumber[wide[order[state] * 256 + c]];
+        }
+    }
+    for (int prev = EdgeContext; prev <= OtherContext; prev++) {
+        start[prev] = renumber[id[index[starts[prev].get()]]];
+    }
+    // The narrowest ids that fit, a small automaton's whole table then stays in L1
+    if (count <= 1 << 8) {
+        table8.assign(table.begin(), table.end());
+    } else if (count <= 1 << 16) {
+        table16.assign(table.begin(), table.end());
+    } else {
+        table32 = std::move(table);
+    }
+}
+
+std::shared_ptr<DFA> DFA::build(NFA2DFA &nfa2dfa, unsigned threads) {
+    // The constructor asks for the start states again, they come out of the cache
+    if (!nfa2dfa.determinize(threads)) {
+        return nullptr;
+    }
+    return std::make_shared<DFA>(nfa2dfa);
+}
+
+template<typename Id>
+long DFA::run(const Id *transitions, std::string_view input, size_t at, bool earliest) const {
+    uint32_t state = startAt(input, at);
+    long last = -1;
+    for (size_t pos = at;; pos++) {
+        if (state < plain) {
+            if (state == DEAD) {
+                break;
+            }
+            pos = exits[state - 1].find(input, pos);
+        }
+        if (pos == input.size()) {
+            if (isEnd(state, EdgeContext)) {
+                last = pos;
+            }
+            break;
+        }
+        char c = input[pos];
+        if (state >= accepting && isEnd(state, context_of(c))) {
+            last = pos;
+            if (earliest) {
+                break;
+            }
+        }
+        state = transitions[state * 256 + static_cast<unsigned char>(c)];
+    }
+    return last;
+}
+
+long DFA::match(std::string_view input, size_t at, bool earliest) const {
+    return with_table([&](auto transitions) {
+        return run(transitions, input, at, earliest);
+    });
+}
+
+long DFA::search(std::string_view input, size_t at) const {
+    // The unanchored DFA reports the earliest end like an earliest match
+    return match(input, at, true);
+}
+
+template<typename Id>
+long DFA::leftmost(const Id *transitions, std::string_view input, size_t at, size_t until) const {
+    // No DFA state is lost, the largest id never names one
+    return leftmost_runs(input, at, until, DEAD, UINT32_MAX, [&](size_t pos) {
+        return startAt(input, pos);
+    }, [&](uint32_t state, char c) -> uint32_t {
+        return transitions[state * 256 + static_cast<unsigned char>(c)];
+    }, [&](uint32_t state, Context next) {
+        return state >= accepting && isEnd(state, next);
+    }, [](uint32_t state) {
+        return state;
+    });
+}
+
+long DFA::leftmost_start(std::string_view input, size_t at, size_t until) const {
+    return with_table([&](auto transitions) {
+        return leftmost(transitions, input, at, until);
+    });
+}
+
+template<typename Id>
+void DFA::batch(const Id *transitions, const std::string_view *inputs, size_t count, bool *results) const {
+    // Bit of the look-ahead Context of each byte, so acceptance is a table lookup and an AND
+    static const auto contextBit = [] {
+        std::array<unsigned char, 256> bits{};
+        for (int c = 0; c < 256; c++) {
+            bits[c] = 1 << context_of(static_cast<char>(c));
+        }
+        return bits;
+    }();
+    const unsigned char *accepts = accept.data();
+    const unsigned char *p[LANES];
+    size_t remaining[LANES];
+    uint32_t state[LANES];
+    uint32_t hit[LANES];
+    size_t index[LANES];
+    bool live[LANES] = {};
+    size_t taken = 0;
+
+    // A lane is decided once a match was seen, the DFA died or its input ran out
+    auto decided = [&](int k) {
+        return remaining[k] == 0 || hit[k] || state[k] == DEAD;
+    };
+    auto answer = [&](int k) {
+        results[index[k]] = hit[k] || (state[k] != DEAD && isEnd(state[k], EdgeContext));
+    };
+    // Puts the next undecided input into lane k, false once the inputs run out
+    auto load = [&](int k) {
+        while (taken < count) {
+            index[k] = taken++;
+            p[k] = reinterpret_cast<const unsigned char *>(inputs[index[k]].data());
+            remaining[k] = inputs[index[k]].size();
+            state[k] = start[EdgeContext];
+            hit[k] = 0;
+            if (!decided(k)) {
+                return live[k] = true;
+            }
+            answer(k);
+        }
+        return live[k] = false;
+    };
+
+    bool full = true;
+    for (int k = 0; k < LANES; k++) {
+        full = load(k) && full;
+    }
+    while (full) {
+        // Every lane steps together without branches until the shortest input runs out: DEAD loops to itself
+        // and hits only accumulate, so decided lanes are only noticed afterwards. The acceptance check is for
+        // the position before each byte, the one at the end of the input is left to answer().
+        size_t steps = BLOCK;
+        for (int k = 0; k < LANES; k++) {
+            steps = std::min(steps, remaining[k]);
+        }
+        for (size_t i = 0; i < steps; i++) {
+#pragma GCC unroll 8
+            for (int k = 0; k < LANES; k++) {
+                unsigned char c = p[k][i];
+                hit[k] |= accepts[state[k]] & contextBit[c];
+                state[k] = transitions[state[k] * 256 + c];
+            }
+        }
+        for (int k = 0; k < LANES; k++) {
+            p[k] += steps;
+            remaining[k] -= steps;
+            if (decided(k)) {
+                answer(k);
+                full = load(k) && full;
+            }
+        }
+    }
+    // Tail: the lanes left over once the inputs run out finish one at a time
+    for (int k = 0; k < LANES; k++) {
+        if (!live[k]) {
+            continue;
+        }
+        for (; !decided(k); p[k]++, remaining[k]--) {
+            hit[k] |= accepts[state[k]] & contextBit[*p[k]];
+            state[k] = transitions[state[k] * 256 + *p[k]];
+        }
+        answer(k);
+    }
+}
+
+void DFA::match_batch(const std::string_view *inputs, size_t count, bool *results) const {
+    with_table([&](auto transitions) {
+        batch(transitions, inputs, count, results);
+    });
+}
@@ -0,0 +1,120 @@
+//
+// Created by Regt on 25-8-13.
+//
+
+#ifndef DFA_H
+#define DFA_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "byteset.h"
+#include "engine.h"
+#include "nfa2dfa.h"
+
+namespace re {
+    // Flat transition table built from the DFANode graph, states that can never reach a match are folded into DEAD.
+    // Ids are laid out in ranges, DEAD (0) < accelerated < plain < accepting, so the matcher tells which states need
+    // more than a lookup with one compare.
+    class DFA : public Engine {
+    public:
+        static constexpr uint32_t DEAD = 0;
+
+        // state * 256 + byte, in the narrowest type that holds every id: only one of the three is filled
+        std::vector<uint8_t> table8;
+        std::vector<uint16_t> table16;
+        std::vector<uint32_t> table32;
+        std::vector<unsigned char> accept; // Same bits as DFANode::accept
+        uint32_t start[4] = {}; // Per look-behind Context
+        uint32_t plain = 1; // First id past the accelerated states
+        uint32_t accepting = 1; // First accepting id
+        // Accelerated states loop on themselves for all but a few bytes, the matcher jumps straight to the next exit
+        std::vector<ByteSet> exits; // Per accelerated state, at state - 1
+
+        explicit DFA(NFA2DFA &nfa2dfa);
+
+        // nullptr if nfa2dfa gives up on its state limit, see NFA2DFA::determinize for threads
+        static std::shared_ptr<DFA> build(NFA2DFA &nfa2dfa, unsigned threads = 1);
+
+        uint32_t size() const {
+            return accept.size();
+        }
+
+        // Calls f with a pointer to whichever table is filled
+        template<typename F>
+        decltype(auto) with_table(F &&f) const {
+            if (!table8.empty()) {
+                return f(table8.data());
+            }
+            if (!table16.empty()) {
+                return f(table16.data());
+            }
+            return f(table32.data());
+        }
+
+        uint32_t next(uint32_t state, char c) const {
+            return with_table([&](auto transitions) -> uint32_t {
+                return transitions[state * 256 + static_cast<unsigned char>(c)];
+            });
+        }
+
+        bool isEnd(uint32_t state, Context next) const {
+            return accept[state] & (1 << next);
+        }
+
+        uint32_t startAt(std::string_view input, size_t at) const {
+            return start[at == 0 ? EdgeContext : context_of(input[at - 1])];
+        }
+
+        // Anchored at `at`, returns the end of the first match found or of the last one before the DFA dies
+        long match(std::string_view input, size_t at, bool earliest) const override;
+
+        // Unanchored from `at`, returns the end of the earliest match
+        long search(std::string_view input, size_t at) const override;
+
+        // For a DFA of a reversed pattern (see AST2NFA): walks backwards from `at` down to `lo` and calls on_start(pos)
+        // for every pos where input[pos, at) matches the pattern, nearest first, until it returns true or the DFA dies.
+        // Returns the last position it reached.
+        template<typename OnStart>
+        size_t rmatch(std::string_view input, size_t at, size_t lo, OnStart &&on_start) const {
+            return with_table([&](auto transitions) {
+                // Backwards the byte after a position is its look-behind
+                uint32_t state = start[at == input.size() ? EdgeContext : context_of(input[at])];
+                size_t pos = at;
+                for (; state != DEAD; pos--) {
+                    Context next = pos == 0 ? EdgeContext : context_of(input[pos - 1]);
+                    if ((state >= accepting && isEnd(state, next) && on_start(pos)) || pos == lo) {
+                        break;
+                    }
+                    state = transitions[state * 256 + static_cast<unsigned char>(input[pos - 1])];
+                }
+                return pos;
+            });
+        }
+
+        // Runs from every start step together and runs reaching the same state merge into the earliest, so at most
+        // size() are ever live
+        long leftmost_start(std::string_view input, size_t at, size_t until) const override;
+
+        // match(inputs[i], 0, true) >= 0 for every input, walking LANES inputs in lockstep so their loads overlap.
+        // Accelerated states are stepped a byte at a time like the rest, the lanes never skip ahead to an exit.
+        void match_batch(const std::string_view *inputs, size_t count, bool *results) const override;
+
+        static constexpr int LANES = 4; // Enough loads in flight to overlap, fewer lanes to refill on mixed lengths
+        static constexpr size_t BLOCK = 16; // Most bytes a lane walks before it is checked
+
+    private:
+        template<typename Id>
+        long run(const Id *transitions, std::string_view input, size_t at, bool earliest) const;
+
+        template<typename Id>
+        long leftmost(const Id *transitions, std::string_view input, size_t at, size_t until) const;
+
+        template<typename Id>
+        void batch(const Id *transitions, const std::string_view *inputs, size_t count, bool *results) const;
+    };
+}
+
+#endif //DFA_H
@@ -0,0 +1,127 @@
+//
+// Created by Regt on 25-8-18.
+//
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ast2nfa.h"
+
+namespace re {
+    // A set of state ids emptied in O(1): an id is in it while its mark equals the epoch. Epochs only grow, so marks
+    // left by earlier epochs never read as taken until the counter wraps and they are cleared.
+    struct Marks {
+        std::vector<uint32_t> mark;
+        uint32_t epoch = 0;
+
+        void clear() {
+            if (++epoch == 0) {
+                std::fill(mark.begin(), mark.end(), 0);
+                epoch = 1;
+            }
+        }
+
+        // Adds id, false if it was already in the set
+        bool insert(uint32_t id) {
+            if (id >= mark.size()) {
+                mark.resize(id + 1, 0);
+            }
+            if (mark[id] == epoch) {
+                return false;
+            }
+            mark[id] = epoch;
+            return true;
+        }
+    };
+
+
+    // One way of running a compiled pattern, RE calls whichever engine compile() picked
+    class Engine {
+    public:
+        virtual ~Engine() = default;
+
+        // Anchored at `at`, returns the end of the first match if earliest, else of the match the MatchKind prefers,
+        // -1 if there is none
+        virtual long match(std::string_view input, size_t at, bool earliest) const = 0;
+
+        // Unanchored from `at`, returns the end of the earliest match, -1 if there is none
+        virtual long search(std::string_view input, size_t at) const = 0;
+
+        // The first position in [at, until] an anchored match starts from, -1 if there is none. Engines that can step
+        // the anchored runs from every position together override this in one pass over the input.
+        virtual long leftmost_start(std::string_view input, size_t at, size_t until) const {
+            for (size_t pos = at; pos <= until; pos++) {
+                if (match(input, pos, true) >= 0) {
+                    return static_cast<long>(pos);
+                }
+            }
+            return -1;
+        }
+
+        // results[i] = match(inputs[i], 0, true) >= 0
+        virtual void match_batch(const std::string_view *inputs, size_t count, bool *results) const {
+            for (size_t i = 0; i < count; i++) {
+                results[i] = match(inputs[i], 0, true) >= 0;
+            }
+        }
+    };
+
+    // Returned by leftmost_runs when a run reaches the lost state
+    constexpr long LOST = -2;
+
+    // The one-pass leftmost_start of the DFAs: steps the anchored runs from every position in [at, until] together,
+    // one run per state since runs in the same state end alike, so the earliest started is kept. start(pos) is the
+    // anchored start state at pos, step(state, c) the state after c, accepts(state, next) whether state matches before
+    // a byte of Context next and id(state) its number in the marks. Returns LOST if start or step gives lost.
+    template<typename Handle, typename Start, typename Step, typename Accepts, typename Id>
+    long leftmost_runs(std::string_view input, size_t at, size_t until, Handle dead, Handle lost, Start start,
+                       Step step, Accepts accepts, Id id) {
+        thread_local std::vector<std::pair<Handle, size_t> > runs; // Live states and where they started, in start order
+        thread_local Marks taken; // States of the runs at the current position
+        taken.clear();
+        runs.clear();
+        long best = -1; // Earliest start seen to match, later runs are dropped
+        for (size_t pos = at;; pos++) {
+            if (best < 0 && pos <= until) {
+                Handle state = start(pos);
+                if (state == lost) {
+                    return LOST;
+                }
+                if (state != dead && taken.insert(id(state))) {
+                    runs.emplace_back(state, pos);
+                }
+            }
+            Context next = pos == input.size() ? EdgeContext : context_of(input[pos]);
+            for (size_t k = 0; k < runs.size(); k++) {
+                if (accepts(runs[k].first, next)) {
+                    best = static_cast<long>(runs[k].second);
+                    runs.resize(k);
+                    break;
+                }
+            }
+            if (pos == input.size() || (runs.empty() && (best >= 0 || pos >= until))) {
+                return best;
+            }
+            taken.clear();
+            size_t kept = 0;
+            for (auto [state, from]: runs) {
+                state = step(state, input[pos]);
+                if (state == lost) {
+                    return LOST;
+                }
+                if (state != dead && taken.insert(id(state))) {
+                    runs[kept++] = {state, from};
+                }
+            }
+            runs.resize(kept);
+        }
+    }
+}
+
+#endif //ENGINE_H
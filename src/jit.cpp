@@ -0,0 +1,290 @@
+//
+// Created by Regt on 25-8-22.
+//
+
+#include "jit.h"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#define RE_JIT
+#endif
+
+using namespace re;
+
+namespace {
+    // Machine code with labels, rel32 references are patched once every label is placed
+    class Assembler {
+        struct Fixup {
+            size_t at;
+            uint32_t label;
+        };
+
+        std::vector<Fixup> fixups;
+
+    public:
+        std::vector<uint8_t> code;
+        std::vector<size_t> labels;
+        std::vector<Fixup> absolutes; // 64-bit addresses, patched after the code is copied to its pages
+
+        uint32_t label() {
+            labels.push_back(0);
+            return labels.size() - 1;
+        }
+
+        void bind(uint32_t label) {
+            labels[label] = code.size();
+        }
+
+        void bytes(std::initializer_list<uint8_t> b) {
+            code.insert(code.end(), b);
+        }
+
+        void imm32(uint32_t v) {
+            for (int i = 0; i < 4; i++) {
+                code.push_back(v >> 8 * i);
+            }
+        }
+
+        // Also the disp32 of a RIP-relative operand, when nothing follows it in the instruction
+        void rel32(uint32_t label) {
+            fixups.push_back({code.size(), label});
+            imm32(0);
+        }
+
+        void address(uint32_t label) {
+            absolutes.push_back({code.size(), label});
+            code.insert(code.end(), 8, 0);
+        }
+
+        void align(size_t n) {
+            code.resize((code.size() + n - 1) / n * n, 0xCC);
+        }
+
+        void jmp(uint32_t label) {
+            bytes({0xE9});
+            rel32(label);
+        }
+
+        void jcc(uint8_t cc, uint32_t label) {
+            bytes({0x0F, static_cast<uint8_t>(0x80 | cc)});
+            rel32(label);
+        }
+
+        void patch() {
+            for (auto &fixup: fixups) {
+                auto rel = static_cast<int32_t>(labels[fixup.label] - (fixup.at + 4));
+                memcpy(&code[fixup.at], &rel, 4);
+            }
+        }
+    };
+
+    constexpr uint8_t E = 0x4, NE = 0x5, BE = 0x6;
+}
+
+JIT::~JIT() {
+#ifdef RE_JIT
+    if (region) {
+        munmap(region, length);
+    }
+#endif
+}
+
+std::shared_ptr<JIT> JIT::build(std::shared_ptr<DFA> dfa) {
+#ifdef RE_JIT
+    if (dfa->size() > MAX_STATES) {
+        return nullptr;
+    }
+    std::shared_ptr<JIT> jit(new JIT(std::move(dfa)));
+    if (jit->compile()) {
+        return jit;
+    }
+#endif
+    return nullptr;
+}
+
+// Registers: rdi input, rsi pos, rdx size, rcx earliest, rax the last match end (the result), r9d the byte,
+// r10 the context table, r11 scratch
+bool JIT::compile() {
+#ifdef RE_JIT
+    Assembler a;
+    uint32_t size = dfa->size();
+    uint32_t ret = a.label();
+    uint32_t contexts = a.label();
+    std::vector<uint32_t> states(size);
+    for (uint32_t state = 1; state < size; state++) {
+        states[state] = a.label();
+    }
+    auto target = [&](uint32_t state) {
+        return state == DFA::DEAD ? ret : states[state];
+    };
+    std::vector<std::pair<uint32_t, uint32_t> > exitTables; // Label, state
+    std::vector<std::pair<uint32_t, uint32_t> > jumpTables;
+    std::vector<int> count(size, 0); // Bytes going to each state, zeroed again after every state
+
+    a.bytes({0x48, 0xC7, 0xC0, 0xFF, 0xFF, 0xFF, 0xFF}); // mov rax, -1
+    a.bytes({0x4C, 0x8D, 0x15}); // lea r10, [rip + contexts]
+    a.rel32(contexts);
+    a.bytes({0x41, 0xFF, 0xE0}); // jmp r8
+    a.bind(ret);
+    a.bytes({0xC3}); // ret
+
+    for (uint32_t state = 1; state < size; state++) {
+        a.bind(states[state]);
+        uint32_t end = a.label();
+        if (state < dfa->plain) {
+            // Accelerated: skip bytes that loop back, four per iteration, against a table of the exits
+            uint32_t table = a.label(), loop = a.label(), exit = a.label();
+            exitTables.emplace_back(table, state);
+            a.bytes({0x4C, 0x8D, 0x1D}); // lea r11, [rip + table]
+            a.rel32(table);
+            a.bind(loop);
+            for (int i = 0; i < 4; i++) {
+                a.bytes({0x48, 0x39, 0xD6}); // cmp rsi, rdx
+                a.jcc(E, end);
+                a.bytes({0x44, 0x0F, 0xB6, 0x0C, 0x37}); // movzx r9d, byte [rdi + rsi]
+                a.bytes({0x43, 0x80, 0x3C, 0x0B, 0x00}); // cmp byte [r11 + r9], 0
+                a.jcc(NE, exit);
+                a.bytes({0x48, 0xFF, 0xC6}); // inc rsi
+            }
+            a.jmp(loop);
+            a.bind(exit);
+        } else {
+            a.bytes({0x48, 0x39, 0xD6}); // cmp rsi, rdx
+            a.jcc(E, end);
+            a.bytes({0x44, 0x0F, 0xB6, 0x0C, 0x37}); // movzx r9d, byte [rdi + rsi]
+            if (uint8_t mask = dfa->accept[state] & ~(1 << EdgeContext)) {
+                uint32_t next = a.label();
+                a.bytes({0x43, 0xF6, 0x04, 0x0A, mask}); // test byte [r10 + r9], mask
+                a.jcc(E, next);
+                a.bytes({0x48, 0x89, 0xF0}); // mov rax, rsi
+                a.bytes({0x48, 0x85, 0xC9}); // test rcx, rcx
+                a.jcc(NE, ret);
+                a.bind(next);
+            }
+        }
+        a.bytes({0x48, 0xFF, 0xC6}); // inc rsi
+
+        // Runs of bytes going to the same state. The state most bytes go to is the fall-through.
+        struct Range {
+            int lo, hi;
+            uint32_t to;
+        };
+        std::vector<Range> ranges;
+        for (int c = 0; c < 256; c++) {
+            uint32_t to = dfa->next(state, static_cast<char>(c));
+            count[to]++;
+            if (!ranges.empty() && ranges.back().to == to) {
+                ranges.back().hi = c;
+            } else {
+                ranges.push_back({c, c, to});
+            }
+        }
+        uint32_t common = ranges[0].to;
+        for (auto &range: ranges) {
+            if (count[range.to] > count[common]) {
+                common = range.to;
+            }
+        }
+        for (auto &range: ranges) {
+            count[range.to] = 0;
+        }
+        std::erase_if(ranges, [&](const Range &range) { return range.to == common; });
+        if (ranges.size() <= MAX_COMPARES) {
+            for (auto &range: ranges) {
+                if (range.lo == range.hi) {
+                    a.bytes({0x41, 0x81, 0xF9}); // cmp r9d, lo
+                    a.imm32(range.lo);
+                    a.jcc(E, target(range.to));
+                } else {
+                    a.bytes({0x45, 0x8D, 0x99}); // lea r11d, [r9 - lo]
+                    a.imm32(-range.lo);
+                    a.bytes({0x41, 0x81, 0xFB}); // cmp r11d, hi - lo
+                    a.imm32(range.hi - range.lo);
+                    a.jcc(BE, target(range.to));
+                }
+            }
+            a.jmp(target(common));
+        } else {
+            uint32_t table = a.label();
+            jumpTables.emplace_back(table, state);
+            a.bytes({0x4C, 0x8D, 0x1D}); // lea r11, [rip + table]
+            a.rel32(table);
+            a.bytes({0x43, 0xFF, 0x24, 0xCB}); // jmp [r11 + r9 * 8]
+        }
+
+        a.bind(end);
+        if (dfa->isEnd(state, EdgeContext)) {
+            a.bytes({0x48, 0x89, 0xF0}); // mov rax, rsi
+        }
+        a.bytes({0xC3}); // ret
+        if (a.code.size() > MAX_LENGTH) {
+            return false;
+        }
+    }
+
+    // Tables after the code: the context bit of every byte, exits of accelerated states, jump tables
+    a.align(64);
+    a.bind(contexts);
+    for (int c = 0; c < 256; c++) {
+        a.code.push_back(1 << context_of(static_cast<char>(c)));
+    }
+    for (auto [table, state]: exitTables) {
+        a.bind(table);
+        for (int c = 0; c < 256; c++) {
+            a.code.push_back(dfa->next(state, static_cast<char>(c)) != state);
+        }
+    }
+    a.align(8);
+    for (auto [table, state]: jumpTables) {
+        a.bind(table);
+        for (int c = 0; c < 256; c++) {
+            a.address(target(dfa->next(state, static_cast<char>(c))));
+        }
+    }
+    if (a.code.size() > MAX_LENGTH) {
+        return false;
+    }
+    a.patch();
+
+    length = a.code.size();
+    region = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        region = nullptr;
+        return false;
+    }
+    auto base = static_cast<uint8_t *>(region);
+    memcpy(base, a.code.data(), length);
+    for (auto &absolute: a.absolutes) {
+        auto address = reinterpret_cast<uint64_t>(base + a.labels[absolute.label]);
+        memcpy(base + absolute.at, &address, 8);
+    }
+    // Never writable and executable at once
+    if (mprotect(region, length, PROT_READ | PROT_EXEC) != 0) {
+        return false;
+    }
+    code = reinterpret_cast<Code>(region);
+    blocks.assign(size, nullptr);
+    for (uint32_t state = 1; state < size; state++) {
+        blocks[state] = base + a.labels[states[state]];
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+long JIT::match(std::string_view input, size_t at, bool earliest) const {
+    uint32_t state = dfa->startAt(input, at);
+    if (state == DFA::DEAD) {
+        return -1;
+    }
+    return code(reinterpret_cast<const unsigned char *>(input.data()), at, input.size(), earliest, blocks[state]);
+}
+
+long JIT::search(std::string_view input, size_t at) const {
+    return match(input, at, true);
+}
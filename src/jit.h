@@ -0,0 +1,63 @@
+//
+// Created by Regt on 25-8-22.
+//
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "dfa.h"
+#include "engine.h"
+
+namespace re {
+    // The DFA compiled to x86-64 code in mmap'd pages, one block per state: the next byte is dispatched with compare
+    // chains or a jump table straight to the next state's block, so the transition table is never loaded.
+    // Accelerated states get an unrolled loop testing each byte against their exit bytes.
+    class JIT : public Engine {
+        using Code = long (*)(const unsigned char *input, size_t pos, size_t size, long earliest, const void *block);
+
+        std::shared_ptr<DFA> dfa; // For match_batch
+        void *region = nullptr;
+        size_t length = 0;
+        Code code = nullptr;
+        std::vector<const void *> blocks; // Per state, nullptr for DEAD
+
+        explicit JIT(std::shared_ptr<DFA> dfa) : dfa(std::move(dfa)) {
+        }
+
+        bool compile();
+
+    public:
+        static constexpr uint32_t MAX_STATES = 4096;
+        static constexpr size_t MAX_LENGTH = 8 << 20; // Code and tables
+        static constexpr size_t MAX_COMPARES = 8; // Byte ranges per state before a jump table is used instead
+
+        JIT(const JIT &) = delete;
+
+        JIT &operator=(const JIT &) = delete;
+
+        ~JIT() override;
+
+        // nullptr off x86-64 Linux, or if the DFA is too big
+        static std::shared_ptr<JIT> build(std::shared_ptr<DFA> dfa);
+
+        long match(std::string_view input, size_t at, bool earliest) const override;
+
+        // For the unanchored DFA
+        long search(std::string_view input, size_t at) const override;
+
+        long leftmost_start(std::string_view input, size_t at, size_t until) const override {
+            return dfa->leftmost_start(input, at, until);
+        }
+
+        void match_batch(const std::string_view *inputs, size_t count, bool *results) const override {
+            dfa->match_batch(inputs, count, results);
+        }
+    };
+}
+
+#endif //JIT_H
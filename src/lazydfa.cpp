@@ -0,0 +1,113 @@
+//
+// Created by Regt on 25-8-20.
+//
+
+#include "lazydfa.h"
+
+#include <algorithm>
+
+using namespace re;
+
+LazyDFA::LazyDFA(const std::shared_ptr<NFANode> &nfa, bool hasAssert, bool ordered, size_t max_bytes) :
+    nfa2dfa(nfa, hasAssert, ordered), fallback(nfa, hasAssert, ordered), max_bytes(max_bytes) {
+    for (int prev = EdgeContext; prev <= OtherContext; prev++) {
+        start[prev] = intern(nfa2dfa.key_of({nfa}, static_cast<Context>(prev)));
+    }
+}
+
+LazyDFA::State *LazyDFA::intern(NFA2DFA::Key key) const {
+    Shard &shard = shards[NFA2DFA::hash(key) % NFA2DFA::SHARDS];
+    std::lock_guard guard(shard.lock);
+    if (auto it = shard.states.find(key); it != shard.states.end()) {
+        return it->second.get();
+    }
+    if (bytes >= max_bytes) {
+        // Already full, do not pay for the expansion only to drop it
+        return nullptr;
+    }
+    auto state = std::make_unique<State>();
+    DFANode node;
+    state->moves = nfa2dfa.expand(key, node);
+    state->accept = node.accept;
+    size_t size = sizeof(State) + key.first.size() * sizeof(key.first[0]);
+    for (auto &[c, moveSet]: state->moves) {
+        size += sizeof(c) + moveSet.size() * sizeof(moveSet[0]);
+    }
+    if (bytes.fetch_add(size) + size > max_bytes) {
+        bytes -= size;
+        return nullptr;
+    }
+    state->id = ids++;
+    State *result = state.get();
+    shard.states.emplace(std::move(key), std::move(state));
+    return result;
+}
+
+const std::vector<std::shared_ptr<NFANode> > *LazyDFA::targets(const State *state, char c) {
+    auto it = std::lower_bound(state->moves.begin(), state->moves.end(), c,
+                               [](auto &move, char b) { return move.first < b; });
+    return it != state->moves.end() && it->first == c ? &it->second : nullptr;
+}
+
+LazyDFA::State *LazyDFA::compute(State *state, char c) const {
+    State *next = &dead;
+    if (auto moveSet = targets(state, c)) {
+        next = intern(nfa2dfa.key_of(*moveSet, context_of(c)));
+        if (!next) {
+            next = &full;
+        }
+    }
+    // Racing threads find the same state through the dedup table, and a thread that found no room stores full, which
+    // only sends matches to the NFA: whichever store lands last is right
+    state->next[static_cast<unsigned char>(c)].store(next, std::memory_order_release);
+    return next;
+}
+
+long LazyDFA::match(std::string_view input, size_t at, bool earliest) const {
+    State *state = start[at == 0 ? EdgeContext : context_of(input[at - 1])];
+    if (!state) {
+        return fallback.match(input, at, earliest);
+    }
+    long last = -1;
+    for (size_t pos = at; state != &dead; pos++) {
+        if (pos == input.size()) {
+            if (state->accept & 1 << EdgeContext) {
+                last = pos;
+            }
+            break;
+        }
+        char c = input[pos];
+        if (state->accept & 1 << context_of(c)) {
+            last = pos;
+            if (earliest) {
+                break;
+            }
+        }
+        State *next = step(state, c);
+        if (next == &full) {
+            return fallback.resume(*targets(state, c), input, pos + 1, last, earliest);
+        }
+        state = next;
+    }
+    return last;
+}
+
+long LazyDFA::search(std::string_view input, size_t at) const {
+    return match(input, at, true);
+}
+
+long LazyDFA::leftmost_start(std::string_view input, size_t at, size_t until) const {
+    // A start state that did not fit is nullptr, a step that does not fit is &full
+    long best = leftmost_runs(input, at, until, &dead, &full, [&](size_t pos) {
+        State *state = start[pos == 0 ? EdgeContext : context_of(input[pos - 1])];
+        return state ? state : &full;
+    }, [&](State *state, char c) {
+        return step(state, c);
+    }, [](State *state, Context next) {
+        return (state->accept & 1 << next) != 0;
+    }, [](State *state) {
+        return state->id;
+    });
+    // Out of memory for new states, the anchored matches fall back to the NFA
+    return best == LOST ? Engine::leftmost_start(input, at, until) : best;
+}
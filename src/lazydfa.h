@@ -0,0 +1,84 @@
+//
+// Created by Regt on 25-8-20.
+//
+
+#ifndef LAZYDFA_H
+#define LAZYDFA_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "engine.h"
+#include "nfa.h"
+#include "nfa2dfa.h"
+
+namespace re {
+    // Determinizes on demand while matching, one state and one transition at a time, sharing what it builds between
+    // all threads. A computed transition is read without locking. A new state is built under the lock of its dedup
+    // shard and published by an atomic store into its predecessor's transition. Past max_bytes no more states are
+    // added: a transition that needs one is set to a sentinel, so the miss is paid once, and matches reaching it carry
+    // on in the NFA simulation from there.
+    class LazyDFA : public Engine {
+        struct State {
+            std::atomic<State *> next[256] = {}; // nullptr until computed
+            unsigned char accept = 0; // Same bits as DFANode::accept
+            uint32_t id = 0; // In creation order, dead is 0
+            std::vector<std::pair<char, std::vector<std::shared_ptr<NFANode> > > > moves; // From NFA2DFA::expand
+        };
+
+        struct Shard {
+            std::mutex lock;
+            std::map<NFA2DFA::Key, std::unique_ptr<State> > states;
+        };
+
+        NFA2DFA nfa2dfa;
+        NFA fallback;
+        size_t max_bytes;
+        mutable std::atomic<size_t> bytes = 0;
+        mutable std::atomic<uint32_t> ids = 1;
+        mutable Shard shards[NFA2DFA::SHARDS];
+        mutable State dead; // No NFA state left
+        mutable State full; // Target of the transitions whose state did not fit in max_bytes
+        State *start[4] = {}; // Per look-behind Context, nullptr if max_bytes is too small for it
+
+        // nullptr if the state is new and does not fit in max_bytes
+        State *intern(NFA2DFA::Key key) const;
+
+        // The state after c, built and published on first use. &full if it does not fit.
+        State *step(State *state, char c) const {
+            State *next = state->next[static_cast<unsigned char>(c)].load(std::memory_order_acquire);
+            return next ? next : compute(state, c);
+        }
+
+        State *compute(State *state, char c) const;
+
+        // The NFA states c moves state to, nullptr if none
+        static const std::vector<std::shared_ptr<NFANode> > *targets(const State *state, char c);
+
+    public:
+        static constexpr size_t MAX_BYTES = 64 << 20;
+
+        LazyDFA(const std::shared_ptr<NFANode> &nfa, bool hasAssert, bool ordered = false,
+                size_t max_bytes = MAX_BYTES);
+
+        // Memory held by the states built so far
+        size_t memory() const {
+            return bytes;
+        }
+
+        long match(std::string_view input, size_t at, bool earliest) const override;
+
+        // Expects the unanchored NFA, it is then the same as an earliest match
+        long search(std::string_view input, size_t at) const override;
+
+        // Like DFA::leftmost_start, runs reaching the same state merge into the earliest
+        long leftmost_start(std::string_view input, size_t at, size_t until) const override;
+    };
+}
+
+#endif //LAZYDFA_H
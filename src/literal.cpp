@@ -0,0 +1,136 @@
+//
+// Created by Regt on 25-8-19.
+//
+
+#include "literal.h"
+
+using namespace re;
+
+namespace {
+    std::shared_ptr<RegexNode> strip_groups(std::shared_ptr<RegexNode> node) {
+        while (true) {
+            if (auto group = std::dynamic_pointer_cast<Group>(node)) {
+                node = group->body;
+            } else if (auto ncgroup = std::dynamic_pointer_cast<NoneCaptureGroup>(node)) {
+                node = ncgroup->body;
+            } else {
+                return node;
+            }
+        }
+    }
+
+    bool string_of(const std::shared_ptr<RegexNode> &node, std::string &str) {
+        if (std::dynamic_pointer_cast<Empty>(node)) {
+            return true;
+        } else if (auto ch = std::dynamic_pointer_cast<Char>(node)) {
+            str += ch->value;
+        } else if (auto set = std::dynamic_pointer_cast<Set>(node)) {
+            if (set->elements.size() != 1) {
+                return false;
+            }
+            str += set->elements[0];
+        } else if (auto group = std::dynamic_pointer_cast<Group>(node)) {
+            return string_of(group->body, str);
+        } else if (auto ncgroup = std::dynamic_pointer_cast<NoneCaptureGroup>(node)) {
+            return string_of(ncgroup->body, str);
+        } else if (auto concat = std::dynamic_pointer_cast<Concat>(node)) {
+            return string_of(concat->left, str) && string_of(concat->right, str);
+        } else if (auto repeat = std::dynamic_pointer_cast<Repeat>(node)) {
+            if (repeat->min != repeat->max) {
+                return false;
+            }
+            for (int i = 0; i < repeat->min; i++) {
+                if (!string_of(repeat->body, str)) {
+                    return false;
+                }
+            }
+        } else {
+            return false;
+        }
+        return str.size() <= Literal::MAX_LENGTH;
+    }
+
+    const std::vector<char> *class_of(const std::shared_ptr<RegexNode> &node, std::vector<char> &single) {
+        if (auto ch = std::dynamic_pointer_cast<Char>(node)) {
+            single = {ch->value};
+            return &single;
+        } else if (auto set = std::dynamic_pointer_cast<Set>(node); set && !set->elements.empty()) {
+            return &set->elements;
+        }
+        return nullptr;
+    }
+}
+
+std::shared_ptr<Literal> Literal::build(const std::shared_ptr<RegexNode> &ast, bool lines) {
+    std::string str;
+    if (!string_of(ast, str) || (lines && str.find('\n') != std::string::npos)) {
+        return nullptr;
+    }
+    return std::make_shared<Literal>(std::move(str));
+}
+
+long Literal::match(std::string_view input, size_t at, bool) const {
+    if (input.substr(at).starts_with(literal)) {
+        return static_cast<long>(at + literal.size());
+    }
+    return -1;
+}
+
+long Literal::search(std::string_view input, size_t at) const {
+    size_t pos = input.find(literal, at);
+    return pos == std::string_view::npos ? -1 : static_cast<long>(pos + literal.size());
+}
+
+ByteClass::ByteClass(const std::vector<char> &elements, bool repeat) : repeat(repeat) {
+    for (char c: elements) {
+        set.insert(c);
+    }
+}
+
+std::shared_ptr<ByteClass> ByteClass::build(const std::shared_ptr<RegexNode> &ast, bool lines) {
+    auto make = [&](std::vector<char> elements, bool repeat) -> std::shared_ptr<ByteClass> {
+        if (lines) {
+            std::erase(elements, '\n');
+        }
+        if (elements.empty()) {
+            return nullptr;
+        }
+        return std::make_shared<ByteClass>(elements, repeat);
+    };
+    std::shared_ptr<RegexNode> node = strip_groups(ast);
+    std::vector<char> single;
+    if (auto elements = class_of(node, single)) {
+        return make(*elements, false);
+    }
+    // x+ is parsed as x followed by x*, sharing the node
+    auto concat = std::dynamic_pointer_cast<Concat>(node);
+    if (!concat) {
+        return nullptr;
+    }
+    auto star = std::dynamic_pointer_cast<Star>(concat->right);
+    if (!star || star->body != concat->left) {
+        return nullptr;
+    }
+    if (auto elements = class_of(strip_groups(concat->left), single)) {
+        return make(*elements, true);
+    }
+    return nullptr;
+}
+
+long ByteClass::match(std::string_view input, size_t at, bool earliest) const {
+    if (at >= input.size() || !set.contains(input[at])) {
+        return -1;
+    }
+    size_t end = at + 1;
+    if (repeat && !earliest) {
+        while (end < input.size() && set.contains(input[end])) {
+            end++;
+        }
+    }
+    return static_cast<long>(end);
+}
+
+long ByteClass::search(std::string_view input, size_t at) const {
+    size_t pos = set.find(input, at);
+    return pos == input.size() ? -1 : static_cast<long>(pos + 1);
+}
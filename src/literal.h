@@ -0,0 +1,52 @@
+//
+// Created by Regt on 25-8-19.
+//
+
+#ifndef LITERAL_H
+#define LITERAL_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "byteset.h"
+#include "engine.h"
+#include "re2ast.h"
+
+namespace re {
+    // A pattern that is one fixed string: matching is a compare and search is a substring search
+    class Literal : public Engine {
+        std::string literal;
+
+    public:
+        static constexpr size_t MAX_LENGTH = 4096; // Longer repeats are left to the automata
+
+        explicit Literal(std::string literal) : literal(std::move(literal)) {
+        }
+
+        // nullptr unless the pattern matches exactly one string, or in line mode (see AST2NFA) if that holds a '\n'
+        static std::shared_ptr<Literal> build(const std::shared_ptr<RegexNode> &ast, bool lines = false);
+
+        long match(std::string_view input, size_t at, bool earliest) const override;
+
+        long search(std::string_view input, size_t at) const override;
+    };
+
+    // A single byte class, optionally repeated with +: search is a ByteSet scan for the first member
+    class ByteClass : public Engine {
+        ByteSet set;
+        bool repeat;
+
+    public:
+        ByteClass(const std::vector<char> &elements, bool repeat);
+
+        // nullptr unless the pattern is a Char or Set, or one followed by +. Line mode leaves '\n' out of the class.
+        static std::shared_ptr<ByteClass> build(const std::shared_ptr<RegexNode> &ast, bool lines = false);
+
+        long match(std::string_view input, size_t at, bool earliest) const override;
+
+        long search(std::string_view input, size_t at) const override;
+    };
+}
+
+#endif //LITERAL_H
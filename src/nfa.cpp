@@ -0,0 +1,137 @@
+//
+// Created by Regt on 25-8-19.
+//
+
+#include "nfa.h"
+
+#include <algorithm>
+
+using namespace re;
+
+thread_local NFA::Scratch NFA::scratch;
+
+NFA::NFA(const std::shared_ptr<NFANode> &nfa, bool hasAssert, bool ordered) : hasAssert(hasAssert), ordered(ordered) {
+    std::vector<NFANode *> nodes = {nfa.get()};
+    index = {{nfa.get(), 0}};
+    auto number = [&](const std::shared_ptr<NFANode> &node) {
+        auto [it, inserted] = index.emplace(node.get(), nodes.size());
+        if (inserted) {
+            nodes.push_back(node.get());
+        }
+        return it->second;
+    };
+    for (size_t i = 0; i < nodes.size(); i++) {
+        NFANode *node = nodes[i];
+        states.push_back({
+            node->isEnd, static_cast<uint32_t>(moves.size()), static_cast<uint32_t>(epsilons.size()),
+            static_cast<uint32_t>(asserts.size())
+        });
+        size_t first = moves.size();
+        for (auto &[c, targets]: node->edges) {
+            for (auto &target: targets) {
+                moves.emplace_back(static_cast<unsigned char>(c), number(target));
+            }
+        }
+        std::stable_sort(moves.begin() + first, moves.end(), [](auto &a, auto &b) { return a.first < b.first; });
+        for (auto &target: node->epsilon_edges) {
+            epsilons.push_back(number(target));
+        }
+        for (auto &[kind, target]: node->assert_edges) {
+            asserts.emplace_back(kind, number(target));
+        }
+    }
+    states.push_back({
+        false, static_cast<uint32_t>(moves.size()), static_cast<uint32_t>(epsilons.size()),
+        static_cast<uint32_t>(asserts.size())
+    });
+}
+
+bool NFA::closure(const std::vector<uint32_t> &from, std::vector<uint32_t> &to, Context prev, Context next,
+                  std::vector<uint32_t> &stack, Marks &taken) const {
+    bool accepts = false;
+    to.clear();
+    for (uint32_t start: from) {
+        stack.push_back(start);
+        while (!stack.empty()) {
+            uint32_t s = stack.back();
+            stack.pop_back();
+            if (!taken.insert(s)) {
+                continue;
+            }
+            to.push_back(s);
+            if (states[s].isEnd) {
+                accepts = true;
+                if (ordered) {
+                    // Everything after a match has lower priority and can never be reported
+                    stack.clear();
+                    return true;
+                }
+            }
+            // Pushed in reverse so the first edge is taken first, epsilon edges ahead of assertions
+            if (hasAssert) {
+                for (uint32_t i = states[s + 1].asserts; i-- > states[s].asserts;) {
+                    if (check_Assert(asserts[i].first, prev, next)) {
+                        stack.push_back(asserts[i].second);
+                    }
+                }
+            }
+            for (uint32_t i = states[s + 1].epsilons; i-- > states[s].epsilons;) {
+                stack.push_back(epsilons[i]);
+            }
+        }
+    }
+    return accepts;
+}
+
+long NFA::match(std::string_view input, size_t at, bool earliest) const {
+    scratch.current.assign(1, 0);
+    return run(input, at, -1, earliest);
+}
+
+long NFA::resume(const std::vector<std::shared_ptr<NFANode> > &nodes, std::string_view input, size_t at, long end,
+                 bool earliest) const {
+    scratch.current.clear();
+    for (auto &node: nodes) {
+        scratch.current.push_back(index.at(node.get()));
+    }
+    return run(input, at, end, earliest);
+}
+
+long NFA::run(std::string_view input, size_t at, long end, bool earliest) const {
+    Marks &taken = scratch.taken;
+    std::vector<uint32_t> &current = scratch.current, &active = scratch.active;
+    for (size_t i = at;; i++) {
+        Context prev = i == 0 ? EdgeContext : context_of(input[i - 1]);
+        Context next = i == input.size() ? EdgeContext : context_of(input[i]);
+        taken.clear();
+        if (closure(current, active, prev, next, scratch.stack, taken)) {
+            end = static_cast<long>(i);
+            if (earliest) {
+                break;
+            }
+        }
+        if (i == input.size()) {
+            break;
+        }
+        auto c = static_cast<unsigned char>(input[i]);
+        current.clear();
+        taken.clear();
+        for (uint32_t s: active) {
+            auto first = moves.begin() + states[s].moves, last = moves.begin() + states[s + 1].moves;
+            auto it = std::lower_bound(first, last, c, [](auto &move, unsigned char b) { return move.first < b; });
+            for (; it != last && it->first == c; ++it) {
+                if (taken.insert(it->second)) {
+                    current.push_back(it->second);
+                }
+            }
+        }
+        if (current.empty()) {
+            break;
+        }
+    }
+    return end;
+}
+
+long NFA::search(std::string_view input, size_t at) const {
+    return match(input, at, true);
+}
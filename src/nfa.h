@@ -0,0 +1,67 @@
+//
+// Created by Regt on 25-8-19.
+//
+
+#ifndef NFA_H
+#define NFA_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ast2nfa.h"
+#include "engine.h"
+
+namespace re {
+    // Simulates the NFA on the set of active states, one step per byte. Slower than the DFA but linear in the NFA size,
+    // for patterns whose DFA would blow up.
+    class NFA : public Engine {
+        struct State {
+            bool isEnd = false;
+            uint32_t moves = 0, epsilons = 0, asserts = 0; // Start of each edge range, the next state's start ends it
+        };
+
+        std::vector<State> states; // Plus a sentinel closing the ranges, states[0] is the start
+        std::vector<std::pair<unsigned char, uint32_t> > moves; // Sorted by byte within a state
+        std::vector<uint32_t> epsilons; // In priority order
+        std::vector<std::pair<AssertKind, uint32_t> > asserts;
+        std::unordered_map<const NFANode *, uint32_t> index; // Of each NFANode in states
+        bool hasAssert;
+        bool ordered; // Same as NFA2DFA::ordered
+
+        // Working memory of match, one per thread and reused across calls and NFAs
+        struct Scratch {
+            Marks taken;
+            std::vector<uint32_t> current, active, stack;
+        };
+
+        static thread_local Scratch scratch;
+
+        // Epsilon closure of `from` into `to`, in priority order like NFA2DFA::_mergeEpsilon, true if it accepts
+        // States in `taken` are skipped, stack is scratch space
+        bool closure(const std::vector<uint32_t> &from, std::vector<uint32_t> &to, Context prev, Context next,
+                     std::vector<uint32_t> &stack, Marks &taken) const;
+
+        // Runs from `at` with the states in scratch.current, end is the match found before `at`
+        long run(std::string_view input, size_t at, long end, bool earliest) const;
+
+    public:
+        NFA(const std::shared_ptr<NFANode> &nfa, bool hasAssert, bool ordered = false);
+
+        long match(std::string_view input, size_t at, bool earliest) const override;
+
+        // Carries on a match that reached `nodes` (before their epsilon closure) at `at`, as left by a lazy DFA out of
+        // room for its next state. end is the match found so far, -1 if none.
+        long resume(const std::vector<std::shared_ptr<NFANode> > &nodes, std::string_view input, size_t at, long end,
+                    bool earliest) const;
+
+        // Expects the unanchored NFA, it is then the same as an earliest match
+        long search(std::string_view input, size_t at) const override;
+    };
+}
+
+#endif //NFA_H
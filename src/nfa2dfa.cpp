@@ -4,9 +4,14 @@
 
 #include "nfa2dfa.h"
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <stack>
+#include <thread>
 #include <utility>
 
 using namespace re;
@@ -15,60 +20,271 @@ void DFANode::addEdge(char c, std::shared_ptr<DFANode> n) {
     edges[c] = std::move(n);
 }
 
-std::set<std::shared_ptr<NFANode> > NFA2DFA::mergeEpsilon(std::set<std::shared_ptr<NFANode> > nodes) {
+std::vector<std::shared_ptr<NFANode> > NFA2DFA::mergeEpsilon(std::vector<std::shared_ptr<NFANode> > nodes) const {
+    return _mergeEpsilon(std::move(nodes), false, EdgeContext, EdgeContext);
+}
+
+std::vector<std::shared_ptr<NFANode> > NFA2DFA::mergeEpsilon(std::vector<std::shared_ptr<NFANode> > nodes,
+                                                             Context prev, Context next) const {
+    return _mergeEpsilon(std::move(nodes), true, prev, next);
+}
+
+std::vector<std::shared_ptr<NFANode> > NFA2DFA::_mergeEpsilon(std::vector<std::shared_ptr<NFANode> > nodes,
+                                                              bool resolve, Context prev, Context next) const {
+    // Depth first in edge order, so the closure lists NFA states from highest to lowest priority
     std::stack<std::shared_ptr<NFANode> > nodeStack;
-    std::set<std::shared_ptr<NFANode> > closure = nodes;
-    for (auto node: nodes) {
-        nodeStack.push(node);
-    }
-    while (!nodeStack.empty()) {
-        std::shared_ptr<NFANode> node = nodeStack.top();
-        nodeStack.pop();
-        for (std::shared_ptr<NFANode> child: node->epsilon_edges) {
-            auto [it, inserted] = closure.insert(child);
-            if (inserted) {
-                nodeStack.push(child);
+    std::set<std::shared_ptr<NFANode> > visited;
+    std::vector<std::shared_ptr<NFANode> > closure;
+    for (auto &start: nodes) {
+        nodeStack.push(start);
+        while (!nodeStack.empty()) {
+            std::shared_ptr<NFANode> node = nodeStack.top();
+            nodeStack.pop();
+            auto [it, inserted] = visited.insert(node);
+            if (!inserted) {
+                continue;
+            }
+            closure.push_back(node);
+            if (ordered && node->isEnd) {
+                // Everything after a match has lower priority and can never be reported
+                return closure;
+            }
+            if (resolve) {
+                for (auto edge = node->assert_edges.rbegin(); edge != node->assert_edges.rend(); ++edge) {
+                    if (check_Assert(edge->first, prev, next)) {
+                        nodeStack.push(edge->second);
+                    }
+                }
+            }
+            for (auto child = node->epsilon_edges.rbegin(); child != node->epsilon_edges.rend(); ++child) {
+                nodeStack.push(*child);
             }
         }
     }
+    if (!ordered) {
+        std::sort(closure.begin(), closure.end());
+    }
     return closure;
 }
 
-std::shared_ptr<DFANode> NFA2DFA::transform() {
-    std::set<std::shared_ptr<NFANode> > start = {nfa};
-    return _transform(start);
+NFA2DFA::~NFA2DFA() {
+    for (auto &[key, node]: cache) {
+        node->edges.clear();
+    }
+}
+
+std::shared_ptr<DFANode> NFA2DFA::transform(Context prev) {
+    std::vector<std::shared_ptr<NFANode> > start = {nfa};
+    std::shared_ptr<DFANode> dfaNode = _transform(start, prev);
+    // States built before the limit was hit stay cached with edges missing, so they can never be handed out
+    return overflow ? nullptr : dfaNode;
 }
 
-std::shared_ptr<DFANode> NFA2DFA::_transform(std::set<std::shared_ptr<NFANode> > nodes) {
-    std::set<std::shared_ptr<NFANode> > closure = mergeEpsilon(std::move(nodes));
-    if (auto it = cache.find(closure); it != cache.end()) {
-        return cache[closure];
+NFA2DFA::Key NFA2DFA::key_of(std::vector<std::shared_ptr<NFANode> > nodes, Context prev) const {
+    std::vector<std::shared_ptr<NFANode> > closure = mergeEpsilon(std::move(nodes));
+    // The look-behind is only read by assertions in the closure. Without any, states differing in it alone would be
+    // split, and a gap like .* before a \b would move between them instead of looping on itself.
+    if (!hasAssert || std::none_of(closure.begin(), closure.end(),
+                                   [](auto &node) { return !node->assert_edges.empty(); })) {
+        prev = EdgeContext;
     }
-    std::shared_ptr<DFANode> dfaNode = std::make_shared<DFANode>();
-    cache[closure] = dfaNode;
-    for (auto node: closure) {
-        if (node->isEnd) {
-            dfaNode->isEnd = true;
-            break;
+    return std::make_pair(std::move(closure), prev);
+}
+
+size_t NFA2DFA::hash(const Key &key) {
+    size_t hash = key.second;
+    for (auto &node: key.first) {
+        hash = hash * 31 + std::hash<NFANode *>()(node.get());
+    }
+    return hash;
+}
+
+std::vector<std::pair<char, std::vector<std::shared_ptr<NFANode> > > > NFA2DFA::expand(const Key &key,
+                                                                                          DFANode &dfaNode) const {
+    auto &[closure, prev] = key;
+    // Assertions are resolved per look-ahead context, once the next byte is known
+    std::vector<std::shared_ptr<NFANode> > closures[4];
+    for (int next = EdgeContext; next <= OtherContext; next++) {
+        closures[next] = hasAssert ? mergeEpsilon(closure, prev, static_cast<Context>(next)) : closure;
+        for (auto &node: closures[next]) {
+            if (node->isEnd) {
+                dfaNode.accept |= 1 << next;
+                break;
+            }
         }
     }
     std::set<char> move;
-    for (auto node: closure) {
-        for (auto edge: node->edges) {
-            move.insert(edge.first);
+    for (int next = NewlineContext; next <= OtherContext; next++) {
+        for (auto &node: closures[next]) {
+            for (auto &edge: node->edges) {
+                if (context_of(edge.first) == next) {
+                    move.insert(edge.first);
+                }
+            }
         }
     }
+    std::vector<std::pair<char, std::vector<std::shared_ptr<NFANode> > > > moves;
     for (char c: move) {
-        std::set<std::shared_ptr<NFANode> > moveSet;
-        for (auto node: closure) {
-            for (auto edge: node->edges[c]) {
-                moveSet.insert(edge);
+        std::vector<std::shared_ptr<NFANode> > moveSet;
+        std::set<std::shared_ptr<NFANode> > seen;
+        for (auto &node: closures[context_of(c)]) {
+            if (auto it = node->edges.find(c); it != node->edges.end()) {
+                for (auto &target: it->second) {
+                    if (seen.insert(target).second) {
+                        moveSet.push_back(target);
+                    }
+                }
             }
         }
-        if (moveSet.empty()) {
-            continue;
+        if (!moveSet.empty()) {
+            moves.emplace_back(c, std::move(moveSet));
+        }
+    }
+    return moves;
+}
+
+std::shared_ptr<DFANode> NFA2DFA::_transform(std::vector<std::shared_ptr<NFANode> > nodes, Context prev) {
+    Key key = key_of(std::move(nodes), prev);
+    if (auto it = cache.find(key); it != cache.end()) {
+        return it->second;
+    }
+    if (overflow || (max_states && cache.size() >= max_states)) {
+        overflow = true;
+        return nullptr;
+    }
+    std::shared_ptr<DFANode> dfaNode = std::make_shared<DFANode>();
+    cache[key] = dfaNode;
+    for (auto &[c, moveSet]: expand(key, *dfaNode)) {
+        std::shared_ptr<DFANode> child = _transform(std::move(moveSet), context_of(c));
+        if (!child) {
+            return nullptr;
         }
-        dfaNode->addEdge(c, _transform(moveSet));
+        dfaNode->addEdge(c, child);
     }
     return dfaNode;
 }
+
+bool NFA2DFA::determinize(unsigned threads) {
+    if (max_states) {
+        threads = std::min<size_t>(threads, max_states / PARALLEL_THRESHOLD);
+    }
+    workers = 1;
+    if (threads <= 1) {
+        for (int prev = EdgeContext; prev <= OtherContext; prev++) {
+            if (!transform(static_cast<Context>(prev))) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // The dedup table is split into shards by key hash, each behind its own lock. Map nodes never move, so a worker
+    // keeps a pointer to the key of every state it queues.
+    struct Shard {
+        std::mutex lock;
+        std::map<Key, std::shared_ptr<DFANode> > states;
+    };
+    using Item = std::pair<const Key *, DFANode *>;
+    // Each worker pops its newest state and steals the oldest of someone else's when it runs dry
+    struct Worklist {
+        std::mutex lock;
+        std::deque<Item> items;
+    };
+    std::vector<Shard> shards(SHARDS);
+    std::vector<Worklist> worklists(threads);
+    std::atomic<size_t> pending = 0; // Queued or being expanded
+    std::atomic<size_t> count = 0;
+    std::atomic<bool> full = false;
+    // Bumped whenever an idle worker may have something to do: a state was queued or the work ran out. Idle workers
+    // sleep on it instead of spinning while another one expands a large state.
+    std::atomic<unsigned> wakeups = 0;
+    auto wake = [&] {
+        wakeups++;
+        wakeups.notify_all();
+    };
+
+    auto push = [&](unsigned self, Item item) {
+        std::lock_guard guard(worklists[self].lock);
+        worklists[self].items.push_back(item);
+    };
+    auto pop = [&](unsigned self, Item &item) {
+        for (unsigned i = 0; i < threads; i++) {
+            Worklist &worklist = worklists[(self + i) % threads];
+            std::lock_guard guard(worklist.lock);
+            if (!worklist.items.empty()) {
+                if (i == 0) {
+                    item = worklist.items.back();
+                    worklist.items.pop_back();
+                } else {
+                    item = worklist.items.front();
+                    worklist.items.pop_front();
+                }
+                return true;
+            }
+        }
+        return false;
+    };
+    // The state for key, queued by whichever worker creates it
+    auto intern = [&](unsigned self, Key key) {
+        Shard &shard = shards[hash(key) % SHARDS];
+        std::lock_guard guard(shard.lock);
+        auto [it, inserted] = shard.states.try_emplace(std::move(key));
+        if (inserted) {
+            // Counted with no limit too, work() stops at PARALLEL_THRESHOLD by it
+            if (++count > max_states && max_states) {
+                full = true;
+            }
+            it->second = std::make_shared<DFANode>();
+            pending++;
+            push(self, {&it->first, it->second.get()});
+            wake();
+        }
+        return it->second;
+    };
+    auto work = [&](unsigned self, size_t until) {
+        Item item;
+        while (pending > 0 && !full && count < until) {
+            // Read before looking for work, so a wake in between makes the wait return at once
+            unsigned seen = wakeups;
+            if (!pop(self, item)) {
+                wakeups.wait(seen);
+                continue;
+            }
+            for (auto &[c, moveSet]: expand(*item.first, *item.second)) {
+                item.second->addEdge(c, intern(self, key_of(std::move(moveSet), context_of(c))));
+            }
+            if (--pending == 0) {
+                wake();
+            }
+        }
+    };
+
+    for (int prev = EdgeContext; prev <= OtherContext; prev++) {
+        intern(0, key_of({nfa}, static_cast<Context>(prev)));
+    }
+    // Small automata finish on this thread before any worker is started
+    work(0, PARALLEL_THRESHOLD);
+    if (pending > 0 && !full) {
+        std::vector<std::thread> started;
+        for (unsigned i = 1; i < threads; i++) {
+            started.emplace_back(work, i, SIZE_MAX);
+        }
+        work(0, SIZE_MAX);
+        for (auto &worker: started) {
+            worker.join();
+        }
+        workers = threads;
+    }
+    if (full) {
+        overflow = true;
+        for (auto &shard: shards) {
+            for (auto &[key, node]: shard.states) {
+                node->edges.clear();
+            }
+        }
+        return false;
+    }
+    for (auto &shard: shards) {
+        cache.merge(shard.states);
+    }
+    return true;
+}
@@ -13,27 +13,85 @@
 namespace re {
     class DFANode {
     public:
-        bool isEnd = false;
+        // Bit per look-ahead Context, accepting only when the next byte (or end of input) is in that context
+        unsigned char accept = 0;
         std::map<char, std::shared_ptr<DFANode> > edges;
 
         void addEdge(char c, std::shared_ptr<DFANode> n);
+
+        bool isEnd(Context next) const {
+            return accept & (1 << next);
+        }
     };
 
 
     class NFA2DFA {
         std::shared_ptr<NFANode> nfa;
+        // Without assertions the look-behind never matters, so every state uses EdgeContext
+        bool hasAssert;
+        // Keep NFA states in priority order and drop the ones behind a match (leftmost-first)
+        bool ordered;
+        // Give up once this many DFA states exist, 0 for no limit
+        size_t max_states;
+        bool overflow = false;
+        unsigned workers = 1; // Threads the last determinize ran on
+
+    public:
+        // A DFA state: the epsilon closure of its NFA states and the look-behind context
+        using Key = std::pair<std::vector<std::shared_ptr<NFANode> >, Context>;
+
+    private:
+        std::map<Key, std::shared_ptr<DFANode> > cache;
 
-        std::map<std::set<std::shared_ptr<NFANode> >, std::shared_ptr<DFANode> > cache;
+        std::vector<std::shared_ptr<NFANode> > mergeEpsilon(std::vector<std::shared_ptr<NFANode> > nodes) const;
 
-        std::set<std::shared_ptr<NFANode> > mergeEpsilon(std::set<std::shared_ptr<NFANode> > nodes);
+        std::vector<std::shared_ptr<NFANode> > mergeEpsilon(std::vector<std::shared_ptr<NFANode> > nodes,
+                                                            Context prev, Context next) const;
+
+        std::vector<std::shared_ptr<NFANode> > _mergeEpsilon(std::vector<std::shared_ptr<NFANode> > nodes,
+                                                             bool resolve, Context prev, Context next) const;
 
     public:
-        explicit NFA2DFA(std::shared_ptr<NFANode> nfa) : nfa(std::move(nfa)) {
+        // Neither touches the cache, so any number of threads may call them
+        Key key_of(std::vector<std::shared_ptr<NFANode> > nodes, Context prev) const;
+
+        // Sets the accept bits of the state for key and returns the NFA states each byte moves it to, sorted by byte
+        std::vector<std::pair<char, std::vector<std::shared_ptr<NFANode> > > > expand(const Key &key,
+                                                                                      DFANode &dfaNode) const;
+
+
+        // Of the NFA states and the context, for picking a dedup shard: SHARDS of them, each behind its own lock
+        static size_t hash(const Key &key);
+
+        static constexpr size_t SHARDS = 64;
+        static constexpr size_t PARALLEL_THRESHOLD = 256; // States built on the calling thread before workers start
+
+        explicit NFA2DFA(std::shared_ptr<NFANode> nfa, bool hasAssert = false, bool ordered = false,
+                         size_t max_states = 0) : nfa(std::move(nfa)), hasAssert(hasAssert), ordered(ordered),
+                                                  max_states(max_states) {
         };
 
-        std::shared_ptr<DFANode> transform();
+        NFA2DFA(const NFA2DFA &) = delete;
+
+        NFA2DFA &operator=(const NFA2DFA &) = delete;
+
+        // Clears the edges of every cached state, which form cycles wherever the DFA loops
+        ~NFA2DFA();
+
+        // nullptr if the DFA needs more than max_states states
+        std::shared_ptr<DFANode> transform(Context prev = EdgeContext);
+
+        // Builds every state up front, with a work-stealing worklist over `threads` threads once the automaton
+        // outgrows PARALLEL_THRESHOLD, but no more than one per PARALLEL_THRESHOLD of max_states. transform() then only
+        // looks states up. The states and edges are the same as the sequential transform builds. False if the DFA
+        // needs more than max_states states.
+        bool determinize(unsigned threads);
+
+        unsigned threads_used() const {
+            return workers;
+        }
 
-        std::shared_ptr<DFANode> _transform(std::set<std::shared_ptr<NFANode> > nodes);
+        std::shared_ptr<DFANode> _transform(std::vector<std::shared_ptr<NFANode> > nodes, Context prev);
     };
 }
 
@@ -0,0 +1,207 @@
+//
+// Created by Regt on 25-8-15.
+//
+
+#include "prefilter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RE_TEDDY_SSSE3
+#endif
+
+using namespace re;
+
+namespace {
+    constexpr size_t MAX_LENGTH = 8;
+    constexpr size_t MAX_SET = 16;
+
+    // Strings every match of a node starts with; exact when the node matches nothing but them
+    struct Literals {
+        std::vector<std::string> strings;
+        bool exact;
+    };
+
+    std::optional<Literals> literals_of(const std::shared_ptr<RegexNode> &node) {
+        if (std::dynamic_pointer_cast<Empty>(node) || std::dynamic_pointer_cast<Assert>(node)) {
+            return Literals{{""}, true};
+        } else if (auto ch = std::dynamic_pointer_cast<Char>(node)) {
+            return Literals{{std::string(1, ch->value)}, true};
+        } else if (auto set = std::dynamic_pointer_cast<Set>(node)) {
+            if (set->elements.empty() || set->elements.size() > MAX_SET) {
+                return std::nullopt;
+            }
+            Literals result{{}, true};
+            for (char c: set->elements) {
+                result.strings.emplace_back(1, c);
+            }
+            return result;
+        } else if (auto group = std::dynamic_pointer_cast<Group>(node)) {
+            return literals_of(group->body);
+        } else if (auto ncgroup = std::dynamic_pointer_cast<NoneCaptureGroup>(node)) {
+            return literals_of(ncgroup->body);
+        } else if (auto _or = std::dynamic_pointer_cast<Or>(node)) {
+            auto l = literals_of(_or->left);
+            auto r = literals_of(_or->right);
+            if (!l || !r || l->strings.size() + r->strings.size() > Prefilter::MAX_LITERALS) {
+                return std::nullopt;
+            }
+            l->strings.insert(l->strings.end(), r->strings.begin(), r->strings.end());
+            l->exact = l->exact && r->exact;
+            return l;
+        } else if (auto concat = std::dynamic_pointer_cast<Concat>(node)) {
+            auto l = literals_of(concat->left);
+            if (!l || !l->exact) {
+                return l;
+            }
+            auto r = literals_of(concat->right);
+            if (!r || l->strings.size() * r->strings.size() > Prefilter::MAX_LITERALS) {
+                l->exact = false;
+                return l;
+            }
+            Literals result{{}, r->exact};
+            for (auto &a: l->strings) {
+                for (auto &b: r->strings) {
+                    std::string s = a + b;
+                    if (s.size() > MAX_LENGTH) {
+                        s.resize(MAX_LENGTH);
+                        result.exact = false;
+                    }
+                    result.strings.push_back(s);
+                }
+            }
+            return result;
+        } else if (auto repeat = std::dynamic_pointer_cast<Repeat>(node)) {
+            if (repeat->min == 0) {
+                return Literals{{""}, false};
+            }
+            auto body = literals_of(repeat->body);
+            if (body && repeat->max != 1) {
+                body->exact = false;
+            }
+            return body;
+        } else if (std::dynamic_pointer_cast<Star>(node)) {
+            return Literals{{""}, false};
+        }
+        return std::nullopt;
+    }
+}
+
+Prefilter::Prefilter(std::vector<std::string> literals) : literals(std::move(literals)) {
+    std::sort(this->literals.begin(), this->literals.end());
+    auto idx = std::unique(this->literals.begin(), this->literals.end());
+    this->literals.erase(idx, this->literals.end());
+    width = MAX_WIDTH;
+    for (auto &literal: this->literals) {
+        width = std::min(width, static_cast<int>(literal.size()));
+    }
+    // Sorted literals go to buckets in runs, so a bucket holds literals with similar prefixes
+    for (size_t i = 0; i < this->literals.size(); i++) {
+        int bucket = static_cast<int>(i * BUCKETS / this->literals.size());
+        buckets[bucket].push_back(static_cast<int>(i));
+        for (int j = 0; j < width; j++) {
+            auto c = static_cast<unsigned char>(this->literals[i][j]);
+            lo[j][c & 0xF] |= 1 << bucket;
+            hi[j][c >> 4] |= 1 << bucket;
+        }
+    }
+}
+
+std::shared_ptr<Prefilter> Prefilter::build(const std::shared_ptr<RegexNode> &ast) {
+    auto result = literals_of(ast);
+    if (!result || result->strings.empty() || result->strings.size() > MAX_LITERALS) {
+        return nullptr;
+    }
+    for (auto &literal: result->strings) {
+        if (literal.empty()) {
+            return nullptr;
+        }
+    }
+    return std::make_shared<Prefilter>(result->strings);
+}
+
+unsigned char Prefilter::fingerprint(const unsigned char *p) const {
+    unsigned char bits = 0xFF;
+    for (int j = 0; j < width; j++) {
+        bits &= lo[j][p[j] & 0xF] & hi[j][p[j] >> 4];
+    }
+    return bits;
+}
+
+bool Prefilter::verify(std::string_view input, size_t pos, unsigned char bits) const {
+    while (bits) {
+        int bucket = __builtin_ctz(bits);
+        bits &= bits - 1;
+        for (int i: buckets[bucket]) {
+            if (input.compare(pos, literals[i].size(), literals[i]) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+size_t Prefilter::find(std::string_view input, size_t at) const {
+    if (literals.size() == 1) {
+        return input.find(literals[0], at);
+    }
+#ifdef RE_TEDDY_SSSE3
+    static const bool ssse3 = __builtin_cpu_supports("ssse3");
+    if (ssse3) {
+        return find_teddy(input, at);
+    }
+#endif
+    return find_scalar(input, at);
+}
+
+size_t Prefilter::find_scalar(std::string_view input, size_t at) const {
+    auto p = reinterpret_cast<const unsigned char *>(input.data());
+    for (size_t pos = at; pos + width <= input.size(); pos++) {
+        if (unsigned char bits = fingerprint(p + pos); bits && verify(input, pos, bits)) {
+            return pos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+#ifdef RE_TEDDY_SSSE3
+__attribute__((target("ssse3")))
+size_t Prefilter::find_teddy(std::string_view input, size_t at) const {
+    auto p = reinterpret_cast<const unsigned char *>(input.data());
+    size_t n = input.size();
+    size_t pos = at;
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i tlo[MAX_WIDTH], thi[MAX_WIDTH];
+    for (int j = 0; j < width; j++) {
+        tlo[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lo[j]));
+        thi[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi[j]));
+    }
+    alignas(16) unsigned char lanes[16];
+    for (; pos + 16 + width - 1 <= n; pos += 16) {
+        // Lane k holds the buckets whose fingerprint matches the bytes starting at pos + k
+        __m128i res = _mm_set1_epi8(static_cast<char>(0xFF));
+        for (int j = 0; j < width; j++) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + pos + j));
+            __m128i l = _mm_shuffle_epi8(tlo[j], _mm_and_si128(chunk, nibble));
+            __m128i h = _mm_shuffle_epi8(thi[j], _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble));
+            res = _mm_and_si128(res, _mm_and_si128(l, h));
+        }
+        unsigned mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(res, _mm_setzero_si128())) & 0xFFFF;
+        if (!mask) {
+            continue;
+        }
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), res);
+        while (mask) {
+            int k = __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (verify(input, pos + k, lanes[k])) {
+                return pos + k;
+            }
+        }
+    }
+    return find_scalar(input, pos);
+}
+#endif
@@ -0,0 +1,57 @@
+//
+// Created by Regt on 25-8-15.
+//
+
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "re2ast.h"
+
+namespace re {
+    // Finds where one of the literals every match must start with occurs, the DFA then verifies the candidate.
+    // Small sets use Teddy: nibble lookup tables over the first bytes pick candidate buckets 16 positions at a time.
+    class Prefilter {
+        static constexpr int BUCKETS = 8;
+        static constexpr int MAX_WIDTH = 3;
+
+        std::vector<std::string> literals;
+        std::vector<int> buckets[BUCKETS];
+        int width; // Fingerprint bytes, no literal is shorter
+        unsigned char lo[MAX_WIDTH][16] = {}; // Buckets with a literal whose j-th byte has this low nibble
+        unsigned char hi[MAX_WIDTH][16] = {};
+
+        unsigned char fingerprint(const unsigned char *p) const;
+
+        bool verify(std::string_view input, size_t pos, unsigned char bits) const;
+
+        // Fingerprint at every position
+        size_t find_scalar(std::string_view input, size_t at) const;
+
+#if defined(__x86_64__) || defined(__i386__)
+        size_t find_teddy(std::string_view input, size_t at) const;
+#endif
+
+    public:
+        static constexpr size_t MAX_LITERALS = 64;
+
+        explicit Prefilter(std::vector<std::string> literals);
+
+        // nullptr when matches do not all begin with one of a few literals
+        static std::shared_ptr<Prefilter> build(const std::shared_ptr<RegexNode> &ast);
+
+        // Length of the shortest literal, capped at MAX_WIDTH
+        int shortest() const {
+            return width;
+        }
+
+        // Start of the first literal at or after `at`, or npos
+        size_t find(std::string_view input, size_t at) const;
+    };
+}
+
+#endif //PREFILTER_H
@@ -2,11 +2,21 @@
 // Created by Regt on 25-8-11.
 //
 
+#include <algorithm>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include "re2ast.h"
 #include "ast2nfa.h"
 #include "nfa2dfa.h"
+#include "dfa.h"
+#include "jit.h"
+#include "bitparallel.h"
+#include "literal.h"
+#include "lazydfa.h"
+#include "prefilter.h"
+#include "reverse.h"
 #include "re.h"
 
 #include <iostream>
@@ -14,40 +24,118 @@
 using namespace re;
 
 void RE::compile() {
-    Regex2AST re2ast(re_str);
-    AST2NFA ast2nfa(re2ast.parse());
-    NFA2DFA nfa2dfa(ast2nfa.build());
-    root = nfa2dfa.transform();
+    Regex2AST re2ast(re_str, flags);
+    std::shared_ptr<RegexNode> ast = re2ast.parse();
+    reversed = false;
+    line_engine = std::make_shared<OnDemand>();
+    batch_engine = std::make_shared<OnDemand>();
+    // Cheapest plan that can run the pattern. A literal or a class is its own search, no prefilter needed.
+    if (auto literal = Literal::build(ast)) {
+        plan_ = LiteralPlan;
+        engine = unanchored = literal;
+        return;
+    }
+    if (auto byteClass = ByteClass::build(ast)) {
+        plan_ = ByteClassPlan;
+        engine = unanchored = byteClass;
+        return;
+    }
+    prefilter = Prefilter::build(ast);
+    plan_automaton(ast);
+    // Without a prefix literal to skip to, or with single bytes that occur everywhere (like \d+ms), a literal further
+    // in may still be found faster than the automaton runs
+    if (!prefilter || prefilter->shortest() < static_cast<int>(ReverseSearch::MIN_LENGTH)) {
+        if (auto reverse = ReverseSearch::build(ast, engine, unanchored)) {
+            unanchored = reverse;
+            reversed = true;
+            prefilter = nullptr;
+        }
+    }
+}
+
+unsigned RE::threads() const {
+    if (flags & SERIAL) {
+        return 1;
+    }
+    return std::clamp(std::thread::hardware_concurrency(), 1u, MAX_THREADS);
 }
 
-int RE::match_pos(std::string input) {
-    int pos = 0;
-    char ch = input[pos];
-    auto node = root;
-    while (node->edges.contains(ch) && pos < input.length()) {
-        node = node->edges.find(ch)->second;
-        pos++;
-        ch = input[pos];
+void RE::plan_automaton(const std::shared_ptr<RegexNode> &ast) {
+    // Small patterns skip determinization, the bit-parallel engine compiles in time linear in the pattern. Asking for
+    // native code asks for the DFA.
+    if (kind != LeftmostFirst && !(flags & NATIVE)) {
+        if (auto bp = BitParallel::build(ast)) {
+            plan_ = BitParallelPlan;
+            engine = unanchored = bp;
+            return;
+        }
     }
-    if (node->isEnd) {
-        return pos;
-    } else {
-        return -1;
+    AST2NFA ast2nfa(ast);
+    std::shared_ptr<NFANode> nfa = ast2nfa.build();
+    AST2NFA unanchored2nfa(ast);
+    std::shared_ptr<NFANode> unanchoredNFA = unanchored2nfa.build(false);
+    NFA2DFA nfa2dfa(nfa, ast2nfa.hasAssert, kind == LeftmostFirst, MAX_DFA_STATES);
+    NFA2DFA unanchored2dfa(unanchoredNFA, unanchored2nfa.hasAssert, false, MAX_DFA_STATES);
+    std::shared_ptr<DFA> dfa = DFA::build(nfa2dfa, threads());
+    std::shared_ptr<DFA> unanchoredDFA = dfa ? DFA::build(unanchored2dfa, threads()) : nullptr;
+    if (dfa && unanchoredDFA) {
+        plan_ = DFAPlan;
+        engine = dfa;
+        unanchored = unanchoredDFA;
+        if (flags & NATIVE) {
+            std::shared_ptr<JIT> jit = JIT::build(dfa);
+            std::shared_ptr<JIT> unanchoredJIT = jit ? JIT::build(unanchoredDFA) : nullptr;
+            if (jit && unanchoredJIT) {
+                plan_ = NativeDFAPlan;
+                engine = jit;
+                unanchored = unanchoredJIT;
+            }
+        }
+        return;
     }
+    plan_ = LazyDFAPlan;
+    engine = std::make_shared<LazyDFA>(nfa, ast2nfa.hasAssert, kind == LeftmostFirst);
+    unanchored = std::make_shared<LazyDFA>(unanchoredNFA, unanchored2nfa.hasAssert);
 }
 
-bool RE::match(std::string input) {
-    int pos = 0;
-    char ch = input[pos];
-    auto node = root;
-    while (node->edges.contains(ch) && pos < input.length()) {
-        node = node->edges.find(ch)->second;
-        pos++;
-        ch = input[pos];
+int RE::match_pos(std::string_view input) {
+    return engine->match(input, 0, kind == Earliest);
+}
+
+bool RE::match(std::string_view input) {
+    return engine->match(input, 0, true) >= 0;
+}
+
+void RE::match_batch(const std::string_view *inputs, size_t count, bool *results) {
+    if (plan_ == BitParallelPlan) {
+        // A bit-parallel step is mostly arithmetic, there is little load latency for interleaving to hide. The DFA
+        // is one load per byte, DFA::match_batch overlaps those. The DFA is capped at MAX_BATCH_STATES so the first
+        // call never stalls on a large determinization, past it the inputs are matched one by one.
+        std::call_once(batch_engine->once, [&] {
+            Regex2AST re2ast(re_str, flags);
+            std::shared_ptr<RegexNode> ast = re2ast.parse();
+            AST2NFA ast2nfa(ast);
+            std::shared_ptr<NFANode> nfa = ast2nfa.build();
+            NFA2DFA nfa2dfa(nfa, ast2nfa.hasAssert, false, MAX_BATCH_STATES);
+            batch_engine->engine = DFA::build(nfa2dfa);
+        });
+        if (batch_engine->engine) {
+            batch_engine->engine->match_batch(inputs, count, results);
+            return;
+        }
     }
-    if (node->isEnd) {
-        return true;
-    } else {
-        return false;
+    engine->match_batch(inputs, count, results);
+}
+
+bool RE::search(std::string_view input) {
+    size_t at = 0;
+    if (prefilter) {
+        // No match starts before the first candidate. Verifying each candidate with an anchored match instead could
+        // rescan the rest of the input per candidate.
+        at = prefilter->find(input, 0);
+        if (at == std::string_view::npos) {
+            return false;
+        }
     }
+    return unanchored->search(input, at) >= 0;
 }
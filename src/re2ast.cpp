@@ -82,6 +82,13 @@ std::string Or::print() const {
 }
 
 
+std::string Assert::print() const {
+    const char *names[] = {"\\A", "\\z", "^", "$", "\\b", "\\B"};
+    std::string str = "Assert(" + std::string(names[kind]) + ")";
+    return str;
+}
+
+
 std::string Group::print() const {
     std::string str = "Group(" + body->print() + ")";
     return str;
@@ -108,6 +115,46 @@ std::vector<char> Regex2AST::make_complement(std::vector<char> elements) {
     return s;
 }
 
+std::vector<char> Regex2AST::fold_case(std::vector<char> elements) {
+    size_t n = elements.size();
+    for (size_t i = 0; i < n; i++) {
+        char c = elements[i];
+        if (c >= 'a' && c <= 'z') {
+            elements.push_back(static_cast<char>(c - 'a' + 'A'));
+        } else if (c >= 'A' && c <= 'Z') {
+            elements.push_back(static_cast<char>(c - 'A' + 'a'));
+        }
+    }
+    std::sort(elements.begin(), elements.end());
+    auto idx = std::unique(elements.begin(), elements.end());
+    elements.erase(idx, elements.end());
+    return elements;
+}
+
+void Regex2AST::parse_Flags() {
+    bool on = true;
+    while (ch != ':' && ch != ')') {
+        int flag;
+        if (ch == '-') {
+            on = false;
+            next();
+            continue;
+        } else if (ch == 'i') {
+            flag = ICASE;
+        } else if (ch == 'm') {
+            flag = MULTILINE;
+        } else {
+            throw std::runtime_error("Wrong Flag");
+        }
+        if (on) {
+            flags |= flag;
+        } else {
+            flags &= ~flag;
+        }
+        next();
+    }
+}
+
 std::shared_ptr<RegexNode> Regex2AST::parse_Char() {
     char c = ch;
     next();
@@ -115,6 +162,12 @@ std::shared_ptr<RegexNode> Regex2AST::parse_Char() {
         std::vector<char> elements = Sigma;
         return std::make_shared<Set>(elements);
     }
+    if (flags & ICASE) {
+        std::vector<char> elements = fold_case({c});
+        if (elements.size() > 1) {
+            return std::make_shared<Set>(elements);
+        }
+    }
     return std::make_shared<Char>(c);
 }
 
@@ -129,9 +182,10 @@ std::shared_ptr<RegexNode> Regex2AST::parse_Set() {
             std::shared_ptr<RegexNode> node = parse_Escape();
             if (auto char_ = std::dynamic_pointer_cast<Char>(node)) {
                 elements.push_back(char_->value);
-            } else {
-                auto set = std::dynamic_pointer_cast<Set>(node);
+            } else if (auto set = std::dynamic_pointer_cast<Set>(node)) {
                 elements.insert(elements.end(), set->elements.begin(), set->elements.end());
+            } else {
+                throw std::runtime_error("Wrong Set");
             }
             continue;
         }
@@ -163,6 +217,9 @@ std::shared_ptr<RegexNode> Regex2AST::parse_Set() {
     std::sort(elements.begin(), elements.end());
     auto idx = std::unique(elements.begin(), elements.end());
     elements.erase(idx, elements.end());
+    if (flags & ICASE) {
+        elements = fold_case(elements);
+    }
     if (neg) {
         elements = make_complement(elements);
     }
@@ -173,6 +230,9 @@ std::shared_ptr<RegexNode> Regex2AST::parse_Repeat(std::shared_ptr<RegexNode> no
     next();
     std::string min, max;
     while (ch != ',' && ch != '}') {
+        if (ch == '\0') {
+            throw std::runtime_error("Wrong Repeat");
+        }
         min += ch;
         next();
     }
@@ -183,6 +243,9 @@ std::shared_ptr<RegexNode> Regex2AST::parse_Repeat(std::shared_ptr<RegexNode> no
     }
     next();
     while (ch != '}') {
+        if (ch == '\0') {
+            throw std::runtime_error("Wrong Repeat");
+        }
         max += ch;
         next();
     }
@@ -191,6 +254,9 @@ std::shared_ptr<RegexNode> Regex2AST::parse_Repeat(std::shared_ptr<RegexNode> no
         min = "0";
         return std::make_shared<Repeat>(node, std::stoi(min), std::stoi(max));
     }
+    if (max != "") {
+        return std::make_shared<Repeat>(node, std::stoi(min), std::stoi(max));
+    }
     return std::make_shared<Concat>(std::make_shared<Repeat>(node, std::stoi(min), std::stoi(min)),
                                     std::make_shared<Star>(node));
 }
@@ -221,6 +287,8 @@ std::shared_ptr<RegexNode> Regex2AST::parse_Atom() {
         node = parse_Set();
     } else if (ch == '(') {
         node = parse_Group();
+    } else if (ch == '^' || ch == '$') {
+        node = parse_Assert();
     } else if (ch == '{') {
         throw std::runtime_error("Wrong Atom");
     } else if (ch == '*') {
@@ -256,15 +324,24 @@ std::shared_ptr<RegexNode> Regex2AST::parse_Or() {
 
 std::shared_ptr<RegexNode> Regex2AST::parse_Group() {
     next();
+    int outer = flags;
     if (ch == '?') {
         next();
-        next(); // Suppose ?: always come together
+        parse_Flags();
+        if (ch == ')') {
+            // Inline flags like (?i) stay on until the enclosing group ends
+            next();
+            return std::make_shared<Empty>();
+        }
+        next();
         std::shared_ptr<RegexNode> node = parse_Or();
         next();
+        flags = outer;
         return std::make_shared<NoneCaptureGroup>(node);
     } else {
         std::shared_ptr<RegexNode> node = parse_Or();
         next();
+        flags = outer;
         return std::make_shared<Group>(node);
     }
 }
@@ -276,7 +353,7 @@ std::shared_ptr<RegexNode> Regex2AST::parse_Plus(std::shared_ptr<RegexNode> node
 
 std::shared_ptr<RegexNode> Regex2AST::parse_Qmark(std::shared_ptr<RegexNode> node) {
     next();
-    return std::make_shared<Or>(std::make_shared<Empty>(), node);
+    return std::make_shared<Or>(node, std::make_shared<Empty>());
 }
 
 std::shared_ptr<RegexNode> Regex2AST::parse_Escape() {
@@ -403,5 +480,38 @@ std::shared_ptr<RegexNode> Regex2AST::parse_Escape() {
         next();
         return std::make_shared<Set>(elements);
     }
-    return std::make_shared<Char>(ch);
+    if (ch == 'b') {
+        next();
+        return std::make_shared<Assert>(WordBoundary);
+    }
+    if (ch == 'B') {
+        next();
+        return std::make_shared<Assert>(NotWordBoundary);
+    }
+    if (ch == 'A') {
+        next();
+        return std::make_shared<Assert>(TextStart);
+    }
+    if (ch == 'z') {
+        next();
+        return std::make_shared<Assert>(TextEnd);
+    }
+    ch_ = ch;
+    next();
+    if (flags & ICASE) {
+        elements = fold_case({ch_});
+        if (elements.size() > 1) {
+            return std::make_shared<Set>(elements);
+        }
+    }
+    return std::make_shared<Char>(ch_);
+}
+
+std::shared_ptr<RegexNode> Regex2AST::parse_Assert() {
+    char c = ch;
+    next();
+    if (c == '^') {
+        return std::make_shared<Assert>(flags & MULTILINE ? LineStart : TextStart);
+    }
+    return std::make_shared<Assert>(flags & MULTILINE ? LineEnd : TextEnd);
 }
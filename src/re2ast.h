@@ -10,6 +10,8 @@
 #include <ostream>
 #include <unordered_map>
 
+#include "re.h"
+
 namespace re {
     class RegexNode {
     public:
@@ -86,6 +88,25 @@ namespace re {
         std::string print() const override;
     };
 
+    enum AssertKind {
+        TextStart, // \A, or ^ without MULTILINE
+        TextEnd, // \z, or $ without MULTILINE
+        LineStart, // ^ with MULTILINE
+        LineEnd, // $ with MULTILINE
+        WordBoundary, // \b
+        NotWordBoundary, // \B
+    };
+
+    class Assert : public RegexNode {
+    public:
+        AssertKind kind;
+
+        explicit Assert(AssertKind kind) : kind(kind) {
+        }
+
+        std::string print() const override;
+    };
+
     class Group : public RegexNode {
     public:
         std::shared_ptr<RegexNode> body;
@@ -139,9 +160,14 @@ namespace re {
         std::string &input;
         int pos = 0;
         char ch;
+        int flags;
 
         std::vector<char> make_complement(std::vector<char> elements);
 
+        std::vector<char> fold_case(std::vector<char> elements);
+
+        void parse_Flags();
+
         std::shared_ptr<RegexNode> parse_Char();
 
         std::shared_ptr<RegexNode> parse_Set();
@@ -164,8 +190,10 @@ namespace re {
 
         std::shared_ptr<RegexNode> parse_Escape();
 
+        std::shared_ptr<RegexNode> parse_Assert();
+
     public:
-        explicit Regex2AST(std::string &input) : input(input) {
+        explicit Regex2AST(std::string &input, int flags = NONE) : input(input), flags(flags) {
             next();
         }
 
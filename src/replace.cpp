@@ -0,0 +1,120 @@
+//
+// Created by Regt on 25-8-20.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "engine.h"
+#include "prefilter.h"
+#include "re.h"
+
+using namespace re;
+
+namespace {
+    // Writes what fits into out and counts the full length
+    struct Buffer {
+        char *out;
+        size_t capacity;
+        size_t length = 0;
+
+        void operator()(std::string_view piece) {
+            if (length < capacity && !piece.empty()) {
+                memcpy(out + length, piece.data(), std::min(piece.size(), capacity - length));
+            }
+            length += piece.size();
+        }
+    };
+}
+
+bool RE::find(std::string_view input, size_t at, size_t &start, size_t &end) {
+    if (prefilter) {
+        // Skip to the first candidate, then run the passes below: one anchored match per candidate could rescan the
+        // rest of the input each time
+        at = prefilter->find(input, at);
+        if (at == std::string_view::npos) {
+            return false;
+        }
+    }
+    // One unanchored pass finds the earliest end. The leftmost match starts at or before it, one more pass finds where.
+    long first = unanchored->search(input, at);
+    if (first < 0) {
+        return false;
+    }
+    long leftmost = engine->leftmost_start(input, at, first);
+    if (leftmost < 0) {
+        return false;
+    }
+    start = leftmost;
+    end = engine->match(input, start, kind == Earliest);
+    return true;
+}
+
+template<typename OnMatch>
+size_t RE::for_each_match(std::string_view input, size_t limit, OnMatch &&on_match) {
+    size_t count = 0;
+    size_t pos = 0;
+    size_t last = std::string_view::npos; // End of the previous match
+    size_t start, end;
+    while (count < limit && pos <= input.size() && find(input, pos, start, end)) {
+        if (start == end && start == last) {
+            pos = start + 1;
+            continue;
+        }
+        on_match(start, end);
+        count++;
+        last = pos = end;
+    }
+    return count;
+}
+
+template<typename Put>
+size_t RE::replace(std::string_view input, std::string_view replacement, size_t limit, Put &&put) {
+    size_t done = 0;
+    size_t count = for_each_match(input, limit, [&](size_t start, size_t end) {
+        put(input.substr(done, start - done));
+        put(replacement);
+        done = end;
+    });
+    put(input.substr(done));
+    return count;
+}
+
+size_t RE::replace_all(std::string_view input, std::string_view replacement, char *out, size_t capacity) {
+    Buffer buffer{out, capacity};
+    replace(input, replacement, std::numeric_limits<size_t>::max(), buffer);
+    return buffer.length;
+}
+
+void RE::replace_all(std::string_view input, std::string_view replacement, std::string &out) {
+    out.clear();
+    replace(input, replacement, std::numeric_limits<size_t>::max(), [&](std::string_view piece) {
+        out.append(piece);
+    });
+}
+
+size_t RE::replace_first(std::string_view input, std::string_view replacement, char *out, size_t capacity) {
+    Buffer buffer{out, capacity};
+    replace(input, replacement, 1, buffer);
+    return buffer.length;
+}
+
+void RE::replace_first(std::string_view input, std::string_view replacement, std::string &out) {
+    out.clear();
+    replace(input, replacement, 1, [&](std::string_view piece) {
+        out.append(piece);
+    });
+}
+
+size_t RE::split(std::string_view input, FunctionRef<void(std::string_view)> on_piece) {
+    size_t done = 0;
+    size_t count = 0;
+    for_each_match(input, std::numeric_limits<size_t>::max(), [&](size_t start, size_t end) {
+        on_piece(input.substr(done, start - done));
+        count++;
+        done = end;
+    });
+    on_piece(input.substr(done));
+    return count + 1;
+}
@@ -0,0 +1,109 @@
+//
+// Created by Regt on 25-8-21.
+//
+
+#include "reverse.h"
+
+#include "ast2nfa.h"
+#include "nfa2dfa.h"
+
+using namespace re;
+
+namespace {
+    void flatten(const std::shared_ptr<RegexNode> &node, std::vector<std::shared_ptr<RegexNode> > &parts) {
+        if (auto concat = std::dynamic_pointer_cast<Concat>(node)) {
+            flatten(concat->left, parts);
+            flatten(concat->right, parts);
+        } else if (auto group = std::dynamic_pointer_cast<Group>(node)) {
+            flatten(group->body, parts);
+        } else if (auto ncgroup = std::dynamic_pointer_cast<NoneCaptureGroup>(node)) {
+            flatten(ncgroup->body, parts);
+        } else {
+            parts.push_back(node);
+        }
+    }
+
+    bool char_of(const std::shared_ptr<RegexNode> &node, char &c) {
+        if (auto ch = std::dynamic_pointer_cast<Char>(node)) {
+            c = ch->value;
+            return true;
+        }
+        if (auto set = std::dynamic_pointer_cast<Set>(node); set && set->elements.size() == 1) {
+            c = set->elements[0];
+            return true;
+        }
+        return false;
+    }
+}
+
+std::shared_ptr<ReverseSearch> ReverseSearch::build(const std::shared_ptr<RegexNode> &ast,
+                                                    std::shared_ptr<Engine> forward,
+                                                    std::shared_ptr<Engine> unanchored) {
+    std::vector<std::shared_ptr<RegexNode> > parts;
+    flatten(ast, parts);
+    // The longest run of single bytes, the last one on a tie so that a suffix wins
+    size_t begin = 0, end = 0;
+    for (size_t i = 0; i < parts.size();) {
+        size_t j = i;
+        char c;
+        while (j < parts.size() && char_of(parts[j], c)) {
+            j++;
+        }
+        if (j > i && j - i >= end - begin) {
+            begin = i;
+            end = j;
+        }
+        i = j > i ? j : i + 1;
+    }
+    if (begin == 0 || end - begin < MIN_LENGTH) {
+        return nullptr;
+    }
+    std::string literal;
+    for (size_t i = begin; i < end; i++) {
+        char c = 0;
+        char_of(parts[i], c);
+        literal += c;
+    }
+    std::shared_ptr<RegexNode> head = parts[0];
+    for (size_t i = 1; i < end; i++) {
+        head = std::make_shared<Concat>(head, parts[i]);
+    }
+    AST2NFA ast2nfa(head, false, true);
+    std::shared_ptr<NFANode> nfa = ast2nfa.build();
+    NFA2DFA nfa2dfa(nfa, ast2nfa.hasAssert, false, RE::MAX_DFA_STATES);
+    std::shared_ptr<DFA> reverse = DFA::build(nfa2dfa);
+    if (!reverse) {
+        return nullptr;
+    }
+    return std::make_shared<ReverseSearch>(std::move(literal), end == parts.size(), std::move(reverse),
+                                           std::move(forward), std::move(unanchored));
+}
+
+long ReverseSearch::search(std::string_view input, size_t at) const {
+    long best = -1;
+    size_t reread = 0;
+    for (size_t pos = input.find(literal, at); pos != std::string_view::npos; pos = input.find(literal, pos + 1)) {
+        size_t end = pos + literal.size();
+        // Matches through this literal or a later one end at or after it
+        if (best >= 0 && end >= static_cast<size_t>(best)) {
+            break;
+        }
+        size_t reached = reverse->rmatch(input, end, at, [&](size_t start) {
+            if (suffix) {
+                best = static_cast<long>(end);
+                return true;
+            }
+            long stop = forward->match(input, start, true);
+            reread += (stop >= 0 ? stop : end) - start;
+            if (stop >= 0 && (best < 0 || stop < best)) {
+                best = stop;
+            }
+            return false;
+        });
+        reread += end - reached;
+        if (reread > 2 * (end - at) + SLACK) {
+            return unanchored->search(input, at);
+        }
+    }
+    return best;
+}
@@ -0,0 +1,51 @@
+//
+// Created by Regt on 25-8-21.
+//
+
+#ifndef REVERSE_H
+#define REVERSE_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "dfa.h"
+#include "engine.h"
+#include "re2ast.h"
+
+namespace re {
+    // Search for patterns whose matches all hold a literal after a broad start, like \w+@example\.com or \d+ms, which
+    // the prefilter cannot help. Finds the literal with a substring search, walks a reverse DFA of everything up to
+    // the literal's end back to where matches can start, then confirms the end with the forward engine. Hands over
+    // to the unanchored engine if the walks start rereading much more than the input.
+    class ReverseSearch : public Engine {
+        std::string literal;
+        bool suffix; // Nothing follows the literal, so a match ends where it does
+        std::shared_ptr<DFA> reverse;
+        std::shared_ptr<Engine> forward; // Anchored
+        std::shared_ptr<Engine> unanchored;
+
+    public:
+        static constexpr size_t MIN_LENGTH = 2;
+        static constexpr size_t SLACK = 4096; // Bytes the walks may reread before the rereading is compared to the input
+
+        ReverseSearch(std::string literal, bool suffix, std::shared_ptr<DFA> reverse, std::shared_ptr<Engine> forward,
+                      std::shared_ptr<Engine> unanchored) : literal(std::move(literal)), suffix(suffix),
+                                                            reverse(std::move(reverse)), forward(std::move(forward)),
+                                                            unanchored(std::move(unanchored)) {
+        }
+
+        // nullptr unless the top-level concatenation has a literal of at least MIN_LENGTH bytes after its first part
+        static std::shared_ptr<ReverseSearch> build(const std::shared_ptr<RegexNode> &ast,
+                                                    std::shared_ptr<Engine> forward,
+                                                    std::shared_ptr<Engine> unanchored);
+
+        long match(std::string_view input, size_t at, bool earliest) const override {
+            return forward->match(input, at, earliest);
+        }
+
+        long search(std::string_view input, size_t at) const override;
+    };
+}
+
+#endif //REVERSE_H
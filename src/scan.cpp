@@ -0,0 +1,149 @@
+//
+// Created by Regt on 25-8-14.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "re2ast.h"
+#include "ast2nfa.h"
+#include "nfa2dfa.h"
+#include "dfa.h"
+#include "literal.h"
+#include "lazydfa.h"
+#include "prefilter.h"
+#include "re.h"
+
+using namespace re;
+
+std::string RE::join(const std::vector<std::string> &patterns) {
+    std::string str;
+    for (auto &pattern: patterns) {
+        if (!str.empty()) {
+            str += '|';
+        }
+        str += "(?:" + pattern + ")";
+    }
+    return str;
+}
+
+size_t RE::scan_lines(std::string_view text, const std::function<void(std::string_view)> &on_line, bool invert) {
+    // Concurrent scans of one RE wait for the first to build it
+    std::call_once(line_engine->once, [&] {
+        // Same plan as compile() where it has a line mode
+        Regex2AST re2ast(re_str, flags);
+        std::shared_ptr<RegexNode> ast = re2ast.parse();
+        std::shared_ptr<Engine> &lines = line_engine->engine;
+        if (plan_ == LiteralPlan) {
+            lines = Literal::build(ast, true);
+        } else if (plan_ == ByteClassPlan) {
+            lines = ByteClass::build(ast, true);
+        }
+        if (!lines) {
+            AST2NFA ast2nfa(ast, true);
+            std::shared_ptr<NFANode> nfa = ast2nfa.build(false);
+            NFA2DFA nfa2dfa(nfa, ast2nfa.hasAssert, false, MAX_DFA_STATES);
+            lines = DFA::build(nfa2dfa, threads());
+            if (!lines) {
+                lines = std::make_shared<LazyDFA>(nfa, ast2nfa.hasAssert);
+            }
+        }
+    });
+    const Engine &line = *line_engine->engine;
+    const char *data = text.data();
+    size_t size = text.size();
+    size_t count = 0;
+    size_t pos = 0;
+    // Unselected lines between pos and from, only walked when inverting
+    auto skipped = [&](size_t from) {
+        while (pos < from) {
+            auto nl = static_cast<const char *>(memchr(data + pos, '\n', from - pos));
+            size_t end = nl ? nl - data : from;
+            on_line(text.substr(pos, end - pos));
+            count++;
+            pos = end + 1;
+        }
+    };
+    while (pos < size) {
+        // Line mode never matches across '\n', so the line of a hit is the one holding its end
+        long end;
+        if (prefilter) {
+            // Only lines holding a literal can match, ending the input at the line end does not change look-ahead
+            size_t candidate = prefilter->find(text, pos);
+            if (candidate == std::string_view::npos) {
+                break;
+            }
+            auto nl = static_cast<const char *>(memrchr(data + pos, '\n', candidate - pos));
+            size_t start = nl ? nl - data + 1 : pos;
+            nl = static_cast<const char *>(memchr(data + candidate, '\n', size - candidate));
+            size_t stop = nl ? nl - data : size;
+            end = line.search(text.substr(0, stop), start);
+            if (end < 0) {
+                if (invert) {
+                    skipped(std::min(stop + 1, size));
+                }
+                pos = stop + 1;
+                continue;
+            }
+        } else {
+            end = line.search(text, pos);
+        }
+        if (end < 0 || (end == static_cast<long>(size) && data[size - 1] == '\n')) {
+            // Past a final '\n' there is no line, so a match there is no match
+            break;
+        }
+        auto nl = static_cast<const char *>(memrchr(data + pos, '\n', end - pos));
+        size_t start = nl ? nl - data + 1 : pos;
+        nl = static_cast<const char *>(memchr(data + end, '\n', size - end));
+        size_t stop = nl ? nl - data : size;
+        if (invert) {
+            skipped(start);
+        } else {
+            on_line(text.substr(start, stop - start));
+            count++;
+        }
+        pos = stop + 1;
+    }
+    if (invert) {
+        skipped(size);
+    }
+    return count;
+}
+
+size_t RE::scan_file(const std::string &path, const std::function<void(std::string_view)> &on_line, bool invert) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat st{};
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw std::runtime_error("Cannot stat " + path);
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + path);
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    size_t count;
+    try {
+        count = scan_lines(std::string_view(static_cast<const char *>(map), st.st_size), on_line, invert);
+    } catch (...) {
+        munmap(map, st.st_size);
+        throw;
+    }
+    munmap(map, st.st_size);
+    return count;
+}
@@ -5,4 +5,21 @@
 
 int main() {
     test_re();
+    test_icase();
+    test_assert();
+    test_match_kind();
+    test_scan_lines();
+    test_prefilter();
+    test_accel();
+    test_layout();
+    test_match_batch();
+    test_bitparallel();
+    test_plan();
+    test_replace();
+    test_replace_random();
+    test_reverse();
+    test_jit();
+    test_jit_random();
+    test_lazydfa();
+    test_determinize();
 }
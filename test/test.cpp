@@ -2,14 +2,477 @@
 // Created by Regt on 25-8-11.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <random>
+#include <regex>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "re2ast.h"
+#include "ast2nfa.h"
+#include "nfa2dfa.h"
+#include "nfa.h"
+#include "dfa.h"
+#include "jit.h"
+#include "lazydfa.h"
 #include "re.h"
 #include "test.h"
 
+// The NFA of pattern as compile() builds it, and whether it has assertions
+static std::pair<std::shared_ptr<re::NFANode>, bool> build_nfa(std::string pattern, bool anchored = true,
+                                                               int flags = re::NONE) {
+    re::Regex2AST re2ast(pattern, flags);
+    re::AST2NFA ast2nfa(re2ast.parse());
+    std::shared_ptr<re::NFANode> node = ast2nfa.build(anchored); // Sets hasAssert
+    return {node, ast2nfa.hasAssert};
+}
+
+// Its DFA, built on one thread up to MAX_DFA_STATES
+static std::shared_ptr<re::DFA> build_dfa(const std::string &pattern, bool ordered = false, bool anchored = true,
+                                          int flags = re::NONE) {
+    auto [node, hasAssert] = build_nfa(pattern, anchored, flags);
+    re::NFA2DFA nfa2dfa(node, hasAssert, ordered, re::RE::MAX_DFA_STATES);
+    return re::DFA::build(nfa2dfa);
+}
+
 void test_re() {
     re::RE re1(R"(\[\[.*\]\])");
     std::cout<<re1.match_pos("[[123]]")<<std::endl;
     std::cout<<re1.match_pos("[[123]][[]]")<<std::endl;
 }
+
+
+void test_icase() {
+    re::RE re1("error: [a-z]+", re::ICASE);
+    std::cout<<re1.match("ERROR: Disk")<<std::endl;
+    re::RE re2("(?i)get|post");
+    std::cout<<re2.match_pos("POST")<<std::endl;
+    re::RE re3("a(?i:b)c");
+    std::cout<<re3.match("aBc")<<std::endl;
+    std::cout<<re3.match("ABC")<<std::endl;
+}
+
+void test_assert() {
+    re::RE re1(R"(^ERROR\b)", re::MULTILINE);
+    std::cout<<re1.search("ok\nERROR disk\n")<<std::endl;
+    std::cout<<re1.search("ok\nERRORS\n")<<std::endl;
+    std::cout<<re1.search("ok ERROR\n")<<std::endl;
+    re::RE re2(R"(\d+$)");
+    std::cout<<re2.search("took 12\nms")<<std::endl;
+    std::cout<<re2.search("took 12ms 345")<<std::endl;
+    re::RE re3(R"(\Bcat)");
+    std::cout<<re3.search("concat")<<std::endl;
+    std::cout<<re3.search("cat")<<std::endl;
+}
+
+void test_match_kind() {
+    re::RE re1("a|abc", re::NONE, re::LeftmostLongest);
+    std::cout<<re1.match_pos("abd")<<std::endl;
+    std::cout<<re1.match_pos("abcd")<<std::endl;
+    re::RE re2("a|abc", re::NONE, re::LeftmostFirst);
+    std::cout<<re2.match_pos("abcd")<<std::endl;
+    re::RE re3("a+", re::NONE, re::Earliest);
+    std::cout<<re3.match_pos("aaaa")<<std::endl;
+    re::RE re4("a{1,2}", re::NONE, re::LeftmostLongest);
+    std::cout<<re4.match_pos("aaaa")<<std::endl;
+}
+
+void test_scan_lines() {
+    re::RE re1(std::vector<std::string>{"^fatal", "timeout$"});
+    std::string text = "info ok\nfatal: disk\nretry timeout\nnot fatal\n";
+    size_t n = re1.scan_lines(text, [](std::string_view line) {
+        std::cout<<line<<std::endl;
+    });
+    std::cout<<n<<std::endl;
+    std::cout<<re1.scan_lines(text, [](std::string_view) {
+    }, true)<<std::endl;
+    // Threads sharing a fresh RE race to build its line engine
+    re::RE re2(R"(\btime(out|d)\b)");
+    std::vector<size_t> counts(4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < counts.size(); i++) {
+        threads.emplace_back([&, i] {
+            counts[i] = re2.scan_lines(text, [](std::string_view) {
+            });
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    std::cout<<counts[0]<<counts[1]<<counts[2]<<counts[3]<<std::endl;
+    // No line follows a trailing '\n'
+    re::RE re3("^$");
+    std::cout<<re3.scan_lines("a\n", [](std::string_view) {
+    })<<re3.scan_lines("a\n\nb\n", [](std::string_view) {
+    })<<re3.scan_lines("a\n\nb\n", [](std::string_view) {
+    }, true)<<std::endl;
+}
+
+void test_prefilter() {
+    re::RE re1("error|fatal|panic|timeout");
+    std::string text(1000, '.');
+    std::cout<<re1.search(text + "panic" + text)<<std::endl;
+    std::cout<<re1.search(text + "pani" + text)<<std::endl;
+    re::RE re2(R"((?i)(get|post) /\w+)");
+    std::cout<<re2.search(text + "Post /x" + text)<<std::endl;
+    std::cout<<re2.search(text + "Post x" + text)<<std::endl;
+    // A candidate every other byte and no match: verifying must stay one pass, not one scan to the end per candidate
+    std::string dense;
+    for (size_t i = 0; i < 200000; i++) {
+        dense += "ab";
+    }
+    re::RE re3("ab.*z");
+    re::RE re4("[a][b].*z|qqqqqqqqq.*z", re::NONE, re::LeftmostFirst);
+    std::string out;
+    std::cout<<re3.search(dense)<<re4.search(dense)<<re4.plan()<<" "<<re3.replace_all(dense, "#", out.data(), 0)<<" "
+             <<re4.replace_all(dense, "#", out.data(), 0)<<std::endl;
+}
+
+void test_accel() {
+    re::RE re1(R"(\[\[.*\]\])");
+    std::string gap(5000, 'x');
+    std::cout<<re1.match_pos("[[" + gap + "]]")<<std::endl;
+    std::cout<<re1.match_pos("[[" + gap + "]")<<std::endl;
+    re::RE re2(R"("[^"]*")");
+    std::cout<<re2.search("key = \"" + gap + "\";")<<std::endl;
+    // Under the DFA plan the .* gap is one state looping on itself, and accelerated, also next to an assertion
+    re::RE re3(R"(\[\[.*\]\])", re::NONE, re::LeftmostFirst);
+    std::cout<<re3.plan()<<re3.match_pos("[[" + gap + "]]");
+    for (std::string pattern: {R"(\[\[.*\]\])", R"(\[\[.*\]\]\B)"}) {
+        std::shared_ptr<re::DFA> dfa = build_dfa(pattern, true);
+        std::cout<<" "<<(dfa->plain > 1);
+    }
+    std::cout<<std::endl;
+}
+
+void test_layout() {
+    // A negated class or . is one state, not one per byte: a handful of states, with 8-bit ids, laid out in ranges
+    for (std::string pattern: {"ab.*z", "a[^x]*b", R"(\w+=[^;]*;)"}) {
+        std::shared_ptr<re::DFA> dfa = build_dfa(pattern);
+        bool ranges = dfa->plain <= dfa->accepting && dfa->accept[re::DFA::DEAD] == 0;
+        for (uint32_t state = 1; state < dfa->size(); state++) {
+            ranges = ranges && (state >= dfa->accepting) == (dfa->accept[state] != 0);
+        }
+        std::cout<<dfa->size()<<!dfa->table8.empty()<<ranges<<" ";
+    }
+    std::cout<<std::endl;
+}
+
+void test_match_batch() {
+    re::RE re1(R"([a-z]+_(id|key))");
+    std::string_view inputs[] = {"user_id", "user", "", "api_key_2", "x_id", "Id", "order_id", "a_ke", "zz_key"};
+    bool results[9];
+    re1.match_batch(inputs, 9, results);
+    for (bool result: results) {
+        std::cout<<result;
+    }
+    std::cout<<std::endl;
+    // More inputs than lanes and longer than a block, through both lockstep engines: bit-parallel and DFA
+    re::RE re2(R"([a-z]+_(id|key))", re::NONE, re::LeftmostFirst);
+    std::vector<std::string> long_inputs;
+    for (size_t i = 0; i < 40; i++) {
+        std::string input(i * 3 % 37, static_cast<char>('a' + i % 26));
+        input += i % 3 == 0 ? "_id" : i % 3 == 1 ? "_ke" : "-key";
+        long_inputs.push_back(i % 7 == 0 ? input + "!" + input : input);
+    }
+    std::vector<std::string_view> views(long_inputs.begin(), long_inputs.end());
+    bool batch1[40], batch2[40];
+    re1.match_batch(views.data(), views.size(), batch1);
+    re2.match_batch(views.data(), views.size(), batch2);
+    size_t agree = 0, matched = 0;
+    for (size_t i = 0; i < views.size(); i++) {
+        bool expected = re1.match(views[i]);
+        agree += batch1[i] == expected && batch2[i] == expected;
+        matched += expected;
+    }
+    std::cout<<re1.plan()<<re2.plan()<<" "<<agree<<" "<<matched<<std::endl;
+    // Its DFA outgrows MAX_BATCH_STATES, the batch falls back to bit-parallel matching per input
+    re::RE re3("[a-z]*a[a-z]{9}x");
+    std::string_view gaps[] = {"abcdefghijx", "zzabcdefghijx", "abcdefghix", "abcdefghijkx"};
+    bool batch3[4];
+    re3.match_batch(gaps, 4, batch3);
+    std::cout<<re3.plan()<<batch3[0]<<batch3[1]<<batch3[2]<<batch3[3]<<std::endl;
+}
+
+void test_bitparallel() {
+    re::RE re1("(ab|a)(bc)?c{2,3}");
+    std::cout<<re1.match_pos("abcccc")<<std::endl;
+    std::cout<<re1.match_pos("abbcccz")<<std::endl;
+    std::cout<<re1.search("xxxxabcc")<<std::endl;
+    re::RE re2("[0-9]+ms", re::NONE, re::Earliest);
+    std::cout<<re2.search("took 12 s, then 340ms")<<std::endl;
+}
+
+void test_plan() {
+    re::RE re1("needle");
+    re::RE re2("[0-9]+");
+    re::RE re3("[a-z]+_(id|key)");
+    re::RE re4("(a|b)*a(a|b)*c", re::NONE, re::LeftmostFirst);
+    re::RE re5(R"(\b[ab]*a[ab]{14}\b)");
+    std::cout<<re1.plan()<<re2.plan()<<re3.plan()<<re4.plan()<<re5.plan()<<std::endl;
+    std::cout<<re1.search("haystack with a needle")<<re2.match_pos("2025-08")<<std::endl;
+    std::cout<<re5.search("x babababababababa y")<<re5.search("x bbbbbbbbbbbbbbbb y")<<std::endl;
+}
+
+void test_replace() {
+    re::RE re1(R"(\d{3}-\d{4})");
+    char buffer[64];
+    size_t length = re1.replace_all("call 555-1234 or 555-9876 now", "XXX-XXXX", buffer, sizeof(buffer));
+    std::cout<<std::string_view(buffer, length)<<std::endl;
+    std::cout<<re1.replace_all("call 555-1234", "XXX-XXXX", buffer, 8)<<std::endl;
+    std::string out;
+    re1.replace_first("555-1234 555-9876", "?", out);
+    std::cout<<out<<std::endl;
+    re::RE re2("a*");
+    re2.replace_all("baaac", "-", out);
+    std::cout<<out<<std::endl;
+    re::RE re3(R"(\s*,\s*)");
+    re3.split("a , b,,c ,", [](std::string_view piece) {
+        std::cout<<"["<<piece<<"]";
+    });
+    std::cout<<std::endl;
+    // Every a starts an anchored attempt that runs to the end: finding the leftmost start must still be one pass
+    std::string input(200000, 'a');
+    input += "c";
+    re::RE re4("a*b|c");
+    re::RE re5("a*b|c", re::NONE, re::LeftmostFirst);
+    re4.replace_all(input, "#", out);
+    std::cout<<re4.plan()<<out.size()<<out.substr(out.size() - 2);
+    re5.replace_all(input, "#", out);
+    std::cout<<re5.plan()<<out.size()<<out.substr(out.size() - 2)<<std::endl;
+}
+
+void test_replace_random() {
+    // replace_all, replace_first and split against std::regex, whose ECMAScript matches are leftmost-first. The
+    // patterns never match empty, where the two step past an empty match differently.
+    std::vector<std::string> patterns = {
+        R"(\d+)", R"(\s*,\s*)", R"((ab|a)(c|bcd))", R"(\bb\w*\b)", R"([a-c]+d|b)", R"(a(?:b|bc)c?)",
+    };
+    std::string alphabet = "abcd01 ,";
+    std::mt19937 rng(3);
+    size_t mismatches = 0;
+    std::string out;
+    for (auto &pattern: patterns) {
+        re::RE re1(pattern, re::NONE, re::LeftmostFirst);
+        std::regex std1(pattern);
+        for (int n = 0; n < 200; n++) {
+            std::string input;
+            size_t length = rng() % 30;
+            for (size_t i = 0; i < length; i++) {
+                input += alphabet[rng() % alphabet.size()];
+            }
+            re1.replace_all(input, "<>", out);
+            mismatches += out != std::regex_replace(input, std1, "<>");
+            re1.replace_first(input, "<>", out);
+            mismatches += out != std::regex_replace(input, std1, "<>", std::regex_constants::format_first_only);
+            std::vector<std::string> pieces, expected;
+            re1.split(input, [&](std::string_view piece) {
+                pieces.emplace_back(piece);
+            });
+            auto last = input.cbegin();
+            for (std::sregex_iterator it(input.begin(), input.end(), std1), end; it != end; ++it) {
+                expected.emplace_back(last, (*it)[0].first);
+                last = (*it)[0].second;
+            }
+            expected.emplace_back(last, input.cend());
+            mismatches += pieces != expected;
+        }
+    }
+    std::cout<<mismatches<<std::endl;
+}
+
+void test_reverse() {
+    re::RE re1(R"(\w+@example\.com)");
+    std::cout<<re1.search("mail joe@example.org, ann@example.com")<<re1.search("@example.com")<<std::endl;
+    re::RE re2(R"(\d+ms\b)");
+    std::cout<<re2.search("took 12 msecs")<<re2.search("took 12ms")<<std::endl;
+    std::cout<<re1.plan()<<re2.plan()<<std::endl;
+    // match_plan() reports the automaton plan() hides behind the reverse search
+    std::cout<<re1.match_plan()<<re2.match_plan()<<std::endl;
+    re::RE re3(R"([a-z]+=\d+;)");
+    std::string out;
+    re3.replace_all("a=1; bb=x; cc=22;", "*", out);
+    std::cout<<out<<std::endl;
+}
+
+void test_jit() {
+    re::RE re1(R"((?:get|put)\s+/[a-z/]+\b)", re::NATIVE);
+    std::cout<<re1.plan()<<re1.match("get /api/users")<<re1.match("post /api")<<re1.search("> put  /a/b")<<std::endl;
+    // Native code takes the DFA over the bit-parallel engine, a literal keeps its own search
+    re::RE re2(R"([a-f0-9]{2}(?:[a-z]+|\d+)!)", re::NATIVE | re::MULTILINE);
+    re::RE re3(R"([a-f0-9]{2}(?:[a-z]+|\d+)!)", re::MULTILINE);
+    re::RE re4("needle", re::NATIVE);
+    std::cout<<re2.plan()<<re3.plan()<<re4.plan()<<std::endl;
+    // Reverse search hides the plan it runs over from plan(), match_plan() tells NATIVE was honoured
+    re::RE re5(R"(\w+@example\.com)", re::NATIVE);
+    std::cout<<re5.plan()<<re5.match_plan()<<re5.search("mail ann@example.com")<<std::endl;
+    std::cout<<re2.match_pos("9fabc!")<<re2.match_pos("9f12!x")<<re2.match_pos("9f!")<<std::endl;
+    std::string out;
+    re2.replace_all("x ff12! 0aqq! zz!", "#", out);
+    std::cout<<out<<std::endl;
+}
+
+void test_jit_random() {
+#if defined(__x86_64__) && defined(__linux__)
+    // The native code against the interpreted DFA it was compiled from, from every start position. The patterns reach
+    // jump tables (more than MAX_COMPARES byte ranges), accelerated states (the mid-pattern gaps too) and the accept
+    // mask at line breaks.
+    std::vector<std::pair<std::string, int> > patterns = {
+        {R"((?:[acegikmoqsuwy]+[.,]|[bdfhjlnprtvxz]+-)+\d)", re::NONE},
+        {R"(^\w+\b|\d+$|\B[a-c]\b)", re::MULTILINE},
+        {R"("[^"]*"|\(a\w*)", re::NONE},
+        {R"((?i)ab|b\s+A$)", re::MULTILINE},
+        {R"(\[.*\]|a[^9]*9\b)", re::NONE},
+    };
+    std::string alphabet = "abcdefgxyz019 .,-\n\"\\(AB[]";
+    std::mt19937 rng(2);
+    std::vector<std::string> inputs(300);
+    for (auto &input: inputs) {
+        size_t length = rng() % 40;
+        for (size_t i = 0; i < length; i++) {
+            input += alphabet[rng() % alphabet.size()];
+        }
+    }
+    // Whether some state has more ranges off its most common target than compare chains take
+    auto tabled = [](const re::DFA &dfa) {
+        for (uint32_t state = 1; state < dfa.size(); state++) {
+            std::vector<int> count(dfa.size(), 0);
+            for (int c = 0; c < 256; c++) {
+                count[dfa.next(state, static_cast<char>(c))]++;
+            }
+            uint32_t common = std::max_element(count.begin(), count.end()) - count.begin();
+            size_t ranges = 0;
+            for (int c = 0; c < 256; c++) {
+                uint32_t to = dfa.next(state, static_cast<char>(c));
+                ranges += to != common && (c == 0 || dfa.next(state, static_cast<char>(c - 1)) != to);
+            }
+            if (ranges > re::JIT::MAX_COMPARES) {
+                return true;
+            }
+        }
+        return false;
+    };
+    size_t mismatches = 0, compiled = 0;
+    bool jumpTable = false, gap = false;
+    for (auto &[pattern, flags]: patterns) {
+        for (bool ordered: {false, true}) {
+            std::shared_ptr<re::DFA> dfa = build_dfa(pattern, ordered, true, flags);
+            std::shared_ptr<re::DFA> unanchoredDFA = build_dfa(pattern, false, false, flags);
+            std::shared_ptr<re::JIT> jit = re::JIT::build(dfa);
+            std::shared_ptr<re::JIT> unanchoredJIT = re::JIT::build(unanchoredDFA);
+            if (!jit || !unanchoredJIT) {
+                continue;
+            }
+            compiled++;
+            jumpTable = jumpTable || tabled(*dfa) || tabled(*unanchoredDFA);
+            // An accelerated state past the start is a gap inside the pattern
+            for (uint32_t state = 1; state < dfa->plain; state++) {
+                gap = gap || std::find(dfa->start, dfa->start + 4, state) == dfa->start + 4;
+            }
+            for (auto &input: inputs) {
+                for (size_t at = 0; at <= input.size(); at++) {
+                    mismatches += jit->match(input, at, true) != dfa->match(input, at, true);
+                    mismatches += jit->match(input, at, false) != dfa->match(input, at, false);
+                    mismatches += unanchoredJIT->search(input, at) != unanchoredDFA->search(input, at);
+                }
+            }
+        }
+    }
+    std::cout<<compiled<<jumpTable<<gap<<" "<<mismatches<<std::endl;
+#else
+    std::cout<<"test_jit_random skipped: the JIT is x86-64 Linux only"<<std::endl;
+#endif
+}
+
+void test_lazydfa() {
+    std::string pattern = R"(\b[ab]*a[ab]{12}\b)";
+    re::RE re1(pattern);
+    auto [node, hasAssert] = build_nfa(pattern);
+    re::NFA nfa(node, hasAssert);
+    auto [unanchoredNode, unanchoredHasAssert] = build_nfa(pattern, false);
+    re::NFA unanchored(unanchoredNode, unanchoredHasAssert);
+    // Room for a few states only, past them matching falls back to the NFA
+    re::LazyDFA small(node, hasAssert, false, 16 << 10);
+
+    std::mt19937 rng(1);
+    std::vector<std::string> inputs(600);
+    for (auto &input: inputs) {
+        size_t length = rng() % 2 ? rng() % 20 : rng() % 200;
+        for (size_t i = 0; i < length; i++) {
+            input += "ab b"[rng() % 4];
+        }
+    }
+    // Every thread walks all inputs, so they race to build the same states
+    std::atomic<size_t> mismatches = 0;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < inputs.size(); i++) {
+                const std::string &input = inputs[(i + t * 150) % inputs.size()];
+                mismatches += re1.match_pos(input) != nfa.match(input, 0, false);
+                mismatches += re1.search(input) != (unanchored.search(input, 0) >= 0);
+                mismatches += small.match(input, 0, false) != nfa.match(input, 0, false);
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    // small is full by now: walks carry on in the NFA from where they ran out of states, from any start and kind
+    re::NFA first(node, hasAssert, true);
+    re::LazyDFA small_first(node, hasAssert, true, 16 << 10);
+    for (size_t round = 0; round < 2; round++) {
+        for (auto &input: inputs) {
+            size_t at = round * input.size() / 3;
+            mismatches += small.match(input, at, true) != nfa.match(input, at, true);
+            mismatches += small.match(input, at, false) != nfa.match(input, at, false);
+            mismatches += small_first.match(input, at, false) != first.match(input, at, false);
+        }
+    }
+    std::cout<<re1.plan()<<" "<<mismatches<<" "<<(small.memory() <= (16 << 10))<<std::endl;
+}
+
+void test_determinize() {
+    // Between PARALLEL_THRESHOLD and MAX_DFA_STATES states: built by the workers, with and without a state limit, and
+    // compared with the sequential build state by state from each start
+    std::string pattern = R"(\b[ab]*a[ab]{8}\b)";
+    auto [node, hasAssert] = build_nfa(pattern, false);
+    re::NFA2DFA sequential(node, hasAssert, false, re::RE::MAX_DFA_STATES);
+    re::NFA2DFA parallel(node, hasAssert, false, re::RE::MAX_DFA_STATES);
+    re::NFA2DFA unlimited(node, hasAssert);
+    std::shared_ptr<re::DFA> dfa1 = re::DFA::build(sequential, 1);
+    auto same_as_sequential = [&](const re::DFA &dfa2) {
+        std::vector<uint32_t> to(dfa1->size(), UINT32_MAX);
+        std::vector<uint32_t> queue;
+        bool same = dfa1->size() == dfa2.size();
+        auto visit = [&](uint32_t s1, uint32_t s2) {
+            if (to[s1] == UINT32_MAX) {
+                to[s1] = s2;
+                queue.push_back(s1);
+            }
+            same = same && to[s1] == s2 && dfa1->accept[s1] == dfa2.accept[s2];
+        };
+        for (int prev = re::EdgeContext; prev <= re::OtherContext && same; prev++) {
+            visit(dfa1->start[prev], dfa2.start[prev]);
+        }
+        for (size_t i = 0; i < queue.size() && same; i++) {
+            for (int c = 0; c < 256; c++) {
+                visit(dfa1->next(queue[i], static_cast<char>(c)), dfa2.next(to[queue[i]], static_cast<char>(c)));
+            }
+        }
+        return same;
+    };
+    std::shared_ptr<re::DFA> dfa2 = re::DFA::build(parallel, 4);
+    std::shared_ptr<re::DFA> dfa3 = re::DFA::build(unlimited, 4);
+    std::cout<<(dfa1->size() > re::NFA2DFA::PARALLEL_THRESHOLD)<<same_as_sequential(*dfa2)<<same_as_sequential(*dfa3)
+            <<parallel.threads_used()<<unlimited.threads_used()<<std::endl;
+    // SERIAL builds the same engines on the calling thread
+    re::RE re1(pattern, re::SERIAL);
+    re::RE re2(pattern);
+    std::string input = "ab babbbbbbbb ba";
+    std::cout<<(re1.plan() == re2.plan())<<re1.search(input)<<re2.search(input)<<std::endl;
+}
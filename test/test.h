@@ -7,4 +7,38 @@
 
 void test_re();
 
+void test_icase();
+
+void test_assert();
+
+void test_match_kind();
+
+void test_scan_lines();
+
+void test_prefilter();
+
+void test_accel();
+
+void test_layout();
+
+void test_match_batch();
+
+void test_bitparallel();
+
+void test_plan();
+
+void test_replace();
+
+void test_replace_random();
+
+void test_reverse();
+
+void test_jit();
+
+void test_jit_random();
+
+void test_lazydfa();
+
+void test_determinize();
+
 #endif //TEST_H
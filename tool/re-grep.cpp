@@ -0,0 +1,96 @@
+//
+// Created by Regt on 25-8-14.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "re.h"
+
+static int usage() {
+    std::cerr << "usage: re-grep [-c] [-v] [-i] [-e PATTERN]... [PATTERN] FILE..." << std::endl;
+    return 2;
+}
+
+int main(int argc, char *argv[]) {
+    bool count = false, invert = false;
+    int flags = re::MULTILINE;
+    std::vector<std::string> patterns;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            i++;
+            break;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            count = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            invert = true;
+        } else if (strcmp(argv[i], "-i") == 0) {
+            flags |= re::ICASE;
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            patterns.emplace_back(argv[++i]);
+        } else {
+            return usage();
+        }
+    }
+    if (patterns.empty()) {
+        if (i >= argc) {
+            return usage();
+        }
+        patterns.emplace_back(argv[i++]);
+    }
+    if (i >= argc) {
+        return usage();
+    }
+    bool prefix = argc - i > 1;
+    for (auto &pattern: patterns) {
+        // Like grep, an empty pattern selects every line
+        if (pattern.empty()) {
+            pattern = "^";
+        }
+    }
+
+    std::optional<re::RE> re;
+    try {
+        re.emplace(patterns, flags, re::Earliest);
+    } catch (const std::exception &e) {
+        std::cerr << "re-grep: " << e.what() << std::endl;
+        return 2;
+    }
+    size_t total = 0;
+    int status = 0;
+    for (; i < argc; i++) {
+        std::string path = argv[i];
+        try {
+            size_t n = re->scan_file(path, [&](std::string_view line) {
+                if (count) {
+                    return;
+                }
+                if (prefix) {
+                    fwrite(path.data(), 1, path.size(), stdout);
+                    fputc(':', stdout);
+                }
+                fwrite(line.data(), 1, line.size(), stdout);
+                fputc('\n', stdout);
+            }, invert);
+            if (count) {
+                if (prefix) {
+                    printf("%s:", path.c_str());
+                }
+                printf("%zu\n", n);
+            }
+            total += n;
+        } catch (const std::exception &e) {
+            std::cerr << "re-grep: " << e.what() << std::endl;
+            status = 2;
+        }
+    }
+    if (status) {
+        return status;
+    }
+    return total ? 0 : 1;
+}